@@ -152,12 +152,14 @@ shared_ptr<Device> AbstractInstance::createDevice(
     const shared_ptr<PhysicalDevice> &physicalDevice,
     const vk::PhysicalDeviceFeatures2 &physicalDeviceFeatures,
     const vector<const char *> &physicalDeviceExtensions,
-    const vector<pair<uint32_t, uint32_t>> &queuesFamily)
+    const vector<pair<uint32_t, uint32_t>> &queuesFamily,
+    const shared_ptr<HostAllocator> &hostAllocator)
 {
     auto device = physicalDevice->createDevice(
         physicalDeviceFeatures,
         physicalDevice->filterAvailableExtensions(physicalDeviceExtensions),
-        queuesFamily
+        queuesFamily,
+        hostAllocator
     );
 
     lock_guard<mutex> locker(m_deviceMutex);
@@ -20,6 +20,7 @@ using namespace std;
 
 class PhysicalDevice;
 class Device;
+class HostAllocator;
 
 class QMVK_EXPORT AbstractInstance : public vk::Instance, public enable_shared_from_this<AbstractInstance>
 {
@@ -55,7 +56,8 @@ public:
         const shared_ptr<PhysicalDevice> &physicalDevice,
         const vk::PhysicalDeviceFeatures2 &physicalDeviceFeatures,
         const vector<const char *> &physicalDeviceExtensions,
-        const vector<pair<uint32_t, uint32_t>> &queuesFamily
+        const vector<pair<uint32_t, uint32_t>> &queuesFamily,
+        const shared_ptr<HostAllocator> &hostAllocator = nullptr // host allocations of the driver, e.g. "ArenaHostAllocator"
     );
     void resetDevice(const shared_ptr<Device> &deviceToReset);
     shared_ptr<Device> device() const;
@@ -0,0 +1,223 @@
+// SPDX-License-Identifier: MIT
+/*
+   QmVk - simple Vulkan library created for QMPlay2
+   Copyright (C) 2020-2025 Błażej Szczygieł
+*/
+
+#include "BarrierBatch.hpp"
+#include "Device.hpp"
+
+#include <limits>
+
+namespace QmVk {
+
+static inline void setMasks2(
+    const BarrierBatch::Masks2 &masks2,
+    vk::PipelineStageFlags srcStage,
+    vk::PipelineStageFlags dstStage,
+    vk::AccessFlags srcAccess,
+    vk::AccessFlags dstAccess,
+    vk::PipelineStageFlags2 &srcStage2,
+    vk::PipelineStageFlags2 &dstStage2,
+    vk::AccessFlags2 &srcAccess2,
+    vk::AccessFlags2 &dstAccess2)
+{
+    if (masks2.srcStage)
+    {
+        srcStage2 = masks2.srcStage;
+        srcAccess2 = masks2.srcAccess;
+    }
+    else
+    {
+        srcStage2 = BarrierBatch::toStage2(srcStage);
+        srcAccess2 = BarrierBatch::toAccess2(srcAccess);
+    }
+
+    if (masks2.dstStage)
+    {
+        dstStage2 = masks2.dstStage;
+        dstAccess2 = masks2.dstAccess;
+    }
+    else
+    {
+        dstStage2 = BarrierBatch::toStage2(dstStage);
+        dstAccess2 = BarrierBatch::toAccess2(dstAccess);
+    }
+}
+
+static inline bool rangesOverlap(uint64_t offsetA, uint64_t sizeA, uint64_t offsetB, uint64_t sizeB, uint64_t remaining)
+{
+    const uint64_t endA = (sizeA == remaining) ? numeric_limits<uint64_t>::max() : offsetA + sizeA;
+    const uint64_t endB = (sizeB == remaining) ? numeric_limits<uint64_t>::max() : offsetB + sizeB;
+    return (offsetA < endB && offsetB < endA);
+}
+
+static bool barriersOverlap(const vk::BufferMemoryBarrier &a, const vk::BufferMemoryBarrier &b)
+{
+    return (a.buffer == b.buffer && rangesOverlap(a.offset, a.size, b.offset, b.size, VK_WHOLE_SIZE));
+}
+static bool barriersOverlap(const vk::ImageMemoryBarrier &a, const vk::ImageMemoryBarrier &b)
+{
+    const auto &rangeA = a.subresourceRange;
+    const auto &rangeB = b.subresourceRange;
+    return (a.image == b.image
+        && (rangeA.aspectMask & rangeB.aspectMask)
+        && rangesOverlap(rangeA.baseMipLevel, rangeA.levelCount, rangeB.baseMipLevel, rangeB.levelCount, VK_REMAINING_MIP_LEVELS)
+        && rangesOverlap(rangeA.baseArrayLayer, rangeA.layerCount, rangeB.baseArrayLayer, rangeB.layerCount, VK_REMAINING_ARRAY_LAYERS)
+    );
+}
+
+BarrierBatch::BarrierBatch(vk::CommandBuffer commandBuffer, Device &device)
+    : m_commandBuffer(commandBuffer)
+    , m_device(device)
+{}
+BarrierBatch::~BarrierBatch()
+{}
+
+void BarrierBatch::addBufferBarrier(
+    vk::PipelineStageFlags srcStage,
+    vk::PipelineStageFlags dstStage,
+    const vk::BufferMemoryBarrier &barrier,
+    const Masks2 &masks2)
+{
+    for (auto &&bufferBarrier : m_bufferBarriers)
+    {
+        if (barriersOverlap(bufferBarrier, barrier))
+        {
+            // The barrier depends on the access set by the pending one
+            flush();
+            break;
+        }
+    }
+
+    m_bufferBarriers.push_back(barrier);
+    m_bufferStages.push_back({srcStage, dstStage, masks2});
+}
+void BarrierBatch::addImageBarrier(
+    vk::PipelineStageFlags srcStage,
+    vk::PipelineStageFlags dstStage,
+    const vk::ImageMemoryBarrier &barrier,
+    const Masks2 &masks2)
+{
+    for (auto &&imageBarrier : m_imageBarriers)
+    {
+        if (barriersOverlap(imageBarrier, barrier))
+        {
+            // The old layout is the new layout of the pending barrier
+            flush();
+            break;
+        }
+    }
+
+    m_imageBarriers.push_back(barrier);
+    m_imageStages.push_back({srcStage, dstStage, masks2});
+}
+
+void BarrierBatch::flush()
+{
+    const auto numBarriers = m_bufferBarriers.size() + m_imageBarriers.size();
+    if (numBarriers == 0)
+        return;
+
+    if (m_device.hasSync2())
+    {
+        flushSync2();
+    }
+    else
+    {
+        // Stage masks are merged, so every barrier waits for all source stages
+        vk::PipelineStageFlags srcStages;
+        vk::PipelineStageFlags dstStages;
+        for (auto &&stages : m_bufferStages)
+        {
+            srcStages |= stages.src;
+            dstStages |= stages.dst;
+        }
+        for (auto &&stages : m_imageStages)
+        {
+            srcStages |= stages.src;
+            dstStages |= stages.dst;
+        }
+
+        m_commandBuffer.pipelineBarrier(
+            srcStages,
+            dstStages,
+            vk::DependencyFlags(),
+            0,
+            nullptr,
+            m_bufferBarriers.size(),
+            m_bufferBarriers.data(),
+            m_imageBarriers.size(),
+            m_imageBarriers.data(),
+            m_device.dld()
+        );
+    }
+
+    m_device.m_savedBarrierCalls += numBarriers - 1;
+
+    m_bufferBarriers.clear();
+    m_bufferStages.clear();
+    m_imageBarriers.clear();
+    m_imageStages.clear();
+}
+
+void BarrierBatch::flushSync2()
+{
+    vector<vk::BufferMemoryBarrier2> bufferBarriers(m_bufferBarriers.size());
+    for (size_t i = 0; i < bufferBarriers.size(); ++i)
+    {
+        const auto &barrier = m_bufferBarriers[i];
+        const auto &stages = m_bufferStages[i];
+        auto &barrier2 = bufferBarriers[i];
+        setMasks2(
+            stages.masks2,
+            stages.src,
+            stages.dst,
+            barrier.srcAccessMask,
+            barrier.dstAccessMask,
+            barrier2.srcStageMask,
+            barrier2.dstStageMask,
+            barrier2.srcAccessMask,
+            barrier2.dstAccessMask
+        );
+        barrier2.srcQueueFamilyIndex = barrier.srcQueueFamilyIndex;
+        barrier2.dstQueueFamilyIndex = barrier.dstQueueFamilyIndex;
+        barrier2.buffer = barrier.buffer;
+        barrier2.offset = barrier.offset;
+        barrier2.size = barrier.size;
+    }
+
+    vector<vk::ImageMemoryBarrier2> imageBarriers(m_imageBarriers.size());
+    for (size_t i = 0; i < imageBarriers.size(); ++i)
+    {
+        const auto &barrier = m_imageBarriers[i];
+        const auto &stages = m_imageStages[i];
+        auto &barrier2 = imageBarriers[i];
+        setMasks2(
+            stages.masks2,
+            stages.src,
+            stages.dst,
+            barrier.srcAccessMask,
+            barrier.dstAccessMask,
+            barrier2.srcStageMask,
+            barrier2.dstStageMask,
+            barrier2.srcAccessMask,
+            barrier2.dstAccessMask
+        );
+        barrier2.oldLayout = barrier.oldLayout;
+        barrier2.newLayout = barrier.newLayout;
+        barrier2.srcQueueFamilyIndex = barrier.srcQueueFamilyIndex;
+        barrier2.dstQueueFamilyIndex = barrier.dstQueueFamilyIndex;
+        barrier2.image = barrier.image;
+        barrier2.subresourceRange = barrier.subresourceRange;
+    }
+
+    vk::DependencyInfo dependencyInfo;
+    dependencyInfo.bufferMemoryBarrierCount = bufferBarriers.size();
+    dependencyInfo.pBufferMemoryBarriers = bufferBarriers.data();
+    dependencyInfo.imageMemoryBarrierCount = imageBarriers.size();
+    dependencyInfo.pImageMemoryBarriers = imageBarriers.data();
+    m_commandBuffer.pipelineBarrier2(dependencyInfo, m_device.dld());
+}
+
+}
@@ -0,0 +1,146 @@
+// SPDX-License-Identifier: MIT
+/*
+   QmVk - simple Vulkan library created for QMPlay2
+   Copyright (C) 2020-2025 Błażej Szczygieł
+*/
+
+#pragma once
+
+#include "QmVkExport.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+namespace QmVk {
+
+using namespace std;
+
+class Device;
+
+/*
+ * Collects buffer and image memory barriers and records them with a single
+ * "vkCmdPipelineBarrier2" call (if synchronization2 is enabled) or a single
+ * "vkCmdPipelineBarrier" call with merged stage masks.
+ *
+ * Barriers within a single call are not ordered, so pending barriers are
+ * flushed before adding a barrier for the same buffer range or image
+ * subresource. Barriers must be recorded explicitly by "flush()".
+ */
+class QMVK_EXPORT BarrierBatch
+{
+public:
+    // Precise synchronization2 masks, empty stage means "use the legacy stage and access mask"
+    struct Masks2
+    {
+        vk::PipelineStageFlags2 srcStage;
+        vk::AccessFlags2 srcAccess;
+        vk::PipelineStageFlags2 dstStage;
+        vk::AccessFlags2 dstAccess;
+    };
+
+    // Precise state of a memory object, valid as long as its legacy state is unchanged
+    struct State2
+    {
+        vk::PipelineStageFlags2 stage;
+        vk::AccessFlags2 accessFlags;
+        vk::PipelineStageFlags legacyStage;
+        vk::AccessFlags legacyAccessFlags;
+
+        inline void setSrc(Masks2 &masks2, vk::PipelineStageFlags currStage, vk::AccessFlags currAccessFlags) const;
+        inline void setDst(const Masks2 &masks2, vk::PipelineStageFlags dstStage, vk::AccessFlags dstAccessFlags);
+
+        inline bool operator==(const State2 &other) const;
+    };
+
+private:
+    struct Stages
+    {
+        vk::PipelineStageFlags src;
+        vk::PipelineStageFlags dst;
+        Masks2 masks2;
+    };
+
+public:
+    static inline vk::PipelineStageFlags2 toStage2(vk::PipelineStageFlags stage);
+    static inline vk::AccessFlags2 toAccess2(vk::AccessFlags access);
+
+public:
+    BarrierBatch(vk::CommandBuffer commandBuffer, Device &device);
+    ~BarrierBatch();
+
+public:
+    inline vk::CommandBuffer commandBuffer() const;
+
+    void addBufferBarrier(
+        vk::PipelineStageFlags srcStage,
+        vk::PipelineStageFlags dstStage,
+        const vk::BufferMemoryBarrier &barrier,
+        const Masks2 &masks2 = {}
+    );
+    void addImageBarrier(
+        vk::PipelineStageFlags srcStage,
+        vk::PipelineStageFlags dstStage,
+        const vk::ImageMemoryBarrier &barrier,
+        const Masks2 &masks2 = {}
+    );
+
+    void flush();
+
+private:
+    void flushSync2();
+
+private:
+    const vk::CommandBuffer m_commandBuffer;
+    Device &m_device;
+
+    vector<vk::BufferMemoryBarrier> m_bufferBarriers;
+    vector<Stages> m_bufferStages;
+
+    vector<vk::ImageMemoryBarrier> m_imageBarriers;
+    vector<Stages> m_imageStages;
+};
+
+/* Inline implementation */
+
+void BarrierBatch::State2::setSrc(Masks2 &masks2, vk::PipelineStageFlags currStage, vk::AccessFlags currAccessFlags) const
+{
+    if (legacyStage != currStage || legacyAccessFlags != currAccessFlags)
+        return;
+
+    masks2.srcStage = stage;
+    masks2.srcAccess = accessFlags;
+}
+void BarrierBatch::State2::setDst(const Masks2 &masks2, vk::PipelineStageFlags dstStage, vk::AccessFlags dstAccessFlags)
+{
+    if (masks2.dstStage)
+    {
+        stage = masks2.dstStage;
+        accessFlags = masks2.dstAccess;
+    }
+    else
+    {
+        stage = toStage2(dstStage);
+        accessFlags = toAccess2(dstAccessFlags);
+    }
+    legacyStage = dstStage;
+    legacyAccessFlags = dstAccessFlags;
+}
+bool BarrierBatch::State2::operator==(const State2 &other) const
+{
+    return (stage == other.stage && accessFlags == other.accessFlags && legacyStage == other.legacyStage && legacyAccessFlags == other.legacyAccessFlags);
+}
+
+vk::PipelineStageFlags2 BarrierBatch::toStage2(vk::PipelineStageFlags stage)
+{
+    return vk::PipelineStageFlags2(static_cast<VkPipelineStageFlags>(stage));
+}
+vk::AccessFlags2 BarrierBatch::toAccess2(vk::AccessFlags access)
+{
+    return vk::AccessFlags2(static_cast<VkAccessFlags>(access));
+}
+
+vk::CommandBuffer BarrierBatch::commandBuffer() const
+{
+    return m_commandBuffer;
+}
+
+}
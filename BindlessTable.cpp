@@ -0,0 +1,238 @@
+// SPDX-License-Identifier: MIT
+/*
+   QmVk - simple Vulkan library created for QMPlay2
+   Copyright (C) 2020-2025 Błażej Szczygieł
+*/
+
+#include "BindlessTable.hpp"
+#include "MemoryObjectDescrs.hpp"
+#include "PhysicalDevice.hpp"
+#include "Device.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+namespace QmVk {
+
+constexpr vk::DescriptorType g_descriptorTypes[] = {
+    vk::DescriptorType::eCombinedImageSampler,
+    vk::DescriptorType::eSampledImage,
+    vk::DescriptorType::eStorageImage,
+    vk::DescriptorType::eStorageBuffer,
+};
+static_assert(size(g_descriptorTypes) == static_cast<size_t>(BindlessTable::Binding::Count));
+
+shared_ptr<BindlessTable> BindlessTable::create(
+    const shared_ptr<Device> &device,
+    const CreateInfo &createInfo)
+{
+    auto bindlessTable = make_shared<BindlessTable>(
+        device
+    );
+    bindlessTable->init(createInfo);
+    return bindlessTable;
+}
+
+BindlessTable::BindlessTable(
+    const shared_ptr<Device> &device)
+    : m_device(device)
+{}
+BindlessTable::~BindlessTable()
+{
+    if (!m_descriptorPool)
+        return;
+
+    // The descriptor set can still be used by submitted command buffers
+    m_device->deferRelease([device = m_device.get(), descriptorPool = m_descriptorPool.release(), descriptorSetLayout = m_descriptorSetLayout.release()] {
+        device->destroyDescriptorPool(descriptorPool, device->allocationCallbacks(), device->dld());
+        device->destroyDescriptorSetLayout(descriptorSetLayout, device->allocationCallbacks(), device->dld());
+    });
+}
+
+void BindlessTable::init(const CreateInfo &createInfo)
+{
+    if (!m_device->hasDescriptorIndexing())
+        throw vk::LogicError("Descriptor indexing is not supported");
+
+    const auto &indexingProps = m_device->physicalDevice()->descriptorIndexingProperties();
+
+    // Combined image samplers and sampled images share the sampled images limit
+    const uint32_t maxSampledImages = min({
+        indexingProps.maxDescriptorSetUpdateAfterBindSampledImages,
+        indexingProps.maxPerStageDescriptorUpdateAfterBindSampledImages,
+    });
+    const uint32_t maxSamplers = min({
+        indexingProps.maxDescriptorSetUpdateAfterBindSamplers,
+        indexingProps.maxPerStageDescriptorUpdateAfterBindSamplers,
+    });
+
+    auto &combinedImageSamplers = m_capacities[static_cast<uint32_t>(Binding::CombinedImageSampler)];
+    combinedImageSamplers = min({createInfo.combinedImageSamplers, maxSampledImages, maxSamplers});
+
+    auto &sampledImages = m_capacities[static_cast<uint32_t>(Binding::SampledImage)];
+    sampledImages = min(createInfo.sampledImages, maxSampledImages - combinedImageSamplers);
+
+    m_capacities[static_cast<uint32_t>(Binding::StorageImage)] = min({
+        createInfo.storageImages,
+        indexingProps.maxDescriptorSetUpdateAfterBindStorageImages,
+        indexingProps.maxPerStageDescriptorUpdateAfterBindStorageImages,
+    });
+    m_capacities[static_cast<uint32_t>(Binding::StorageBuffer)] = min({
+        createInfo.storageBuffers,
+        indexingProps.maxDescriptorSetUpdateAfterBindStorageBuffers,
+        indexingProps.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+    });
+
+    constexpr uint32_t bindingsCount = static_cast<uint32_t>(Binding::Count);
+
+    vector<vk::DescriptorSetLayoutBinding> descriptorSetLayoutBindings(bindingsCount);
+    vector<vk::DescriptorBindingFlags> descriptorBindingFlags(bindingsCount);
+    vector<vk::DescriptorPoolSize> descriptorPoolSizes;
+    for (uint32_t i = 0; i < bindingsCount; ++i)
+    {
+        auto &descriptorSetLayoutBinding = descriptorSetLayoutBindings[i];
+        descriptorSetLayoutBinding.binding = i;
+        descriptorSetLayoutBinding.descriptorType = g_descriptorTypes[i];
+        descriptorSetLayoutBinding.descriptorCount = m_capacities[i];
+        descriptorSetLayoutBinding.stageFlags = vk::ShaderStageFlagBits::eAll;
+
+        // Not all descriptors must be valid and unused descriptors can be updated while the set is in use
+        descriptorBindingFlags[i] =
+            vk::DescriptorBindingFlagBits::ePartiallyBound |
+            vk::DescriptorBindingFlagBits::eUpdateAfterBind |
+            vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending
+        ;
+
+        if (m_capacities[i] > 0)
+            descriptorPoolSizes.emplace_back(g_descriptorTypes[i], m_capacities[i]);
+
+        m_usedIndices[i].resize(m_capacities[i]);
+    }
+
+    vk::DescriptorSetLayoutBindingFlagsCreateInfo descriptorSetLayoutBindingFlagsCreateInfo;
+    descriptorSetLayoutBindingFlagsCreateInfo.bindingCount = descriptorBindingFlags.size();
+    descriptorSetLayoutBindingFlagsCreateInfo.pBindingFlags = descriptorBindingFlags.data();
+
+    vk::DescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo;
+    descriptorSetLayoutCreateInfo.pNext = &descriptorSetLayoutBindingFlagsCreateInfo;
+    descriptorSetLayoutCreateInfo.flags = vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool;
+    descriptorSetLayoutCreateInfo.bindingCount = descriptorSetLayoutBindings.size();
+    descriptorSetLayoutCreateInfo.pBindings = descriptorSetLayoutBindings.data();
+    m_descriptorSetLayout = m_device->createDescriptorSetLayoutUnique(descriptorSetLayoutCreateInfo, m_device->allocationCallbacks(), m_device->dld());
+
+    vk::DescriptorPoolCreateInfo descriptorPoolCreateInfo;
+    descriptorPoolCreateInfo.flags = vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind;
+    descriptorPoolCreateInfo.maxSets = 1;
+    descriptorPoolCreateInfo.poolSizeCount = descriptorPoolSizes.size();
+    descriptorPoolCreateInfo.pPoolSizes = descriptorPoolSizes.data();
+    m_descriptorPool = m_device->createDescriptorPoolUnique(descriptorPoolCreateInfo, m_device->allocationCallbacks(), m_device->dld());
+
+    vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo;
+    descriptorSetAllocateInfo.descriptorPool = *m_descriptorPool;
+    descriptorSetAllocateInfo.descriptorSetCount = 1;
+    descriptorSetAllocateInfo.pSetLayouts = &*m_descriptorSetLayout;
+    m_descriptorSet = m_device->allocateDescriptorSets(descriptorSetAllocateInfo, m_device->dld())[0];
+}
+
+BindlessTable::Slot BindlessTable::add(const MemoryObjectDescr &memoryObjectDescr)
+{
+    const auto &descriptorType = memoryObjectDescr.descriptorType();
+    const auto &descriptorInfos = memoryObjectDescr.descriptorInfos();
+
+#ifndef QMVK_NO_GRAPHICS
+    if (!descriptorType.immutableSamplers.empty())
+        throw vk::LogicError("Immutable samplers can't be used in bindless table");
+#endif
+
+    Slot slot;
+    slot.binding = getBinding(descriptorType.type);
+    slot.count = descriptorInfos.size();
+    if (slot.count == 0)
+        throw vk::LogicError("No descriptors to add to bindless table");
+
+    vector<shared_ptr<MemoryObjectBase>> objects;
+    MemoryObjectDescrs({memoryObjectDescr}).iterateMemoryObjects([&](const shared_ptr<MemoryObjectBase> &object) {
+        objects.push_back(object);
+    });
+
+    lock_guard<mutex> locker(m_mutex);
+
+    slot.index = allocateIndices(slot.binding, slot.count);
+
+    vector<vk::WriteDescriptorSet> writeDescriptorSets(slot.count);
+    for (uint32_t i = 0; i < slot.count; ++i)
+    {
+        auto &writeDescriptorSet = writeDescriptorSets[i];
+        writeDescriptorSet.dstSet = m_descriptorSet;
+        writeDescriptorSet.dstBinding = static_cast<uint32_t>(slot.binding);
+        writeDescriptorSet.dstArrayElement = slot.index + i;
+        writeDescriptorSet.descriptorCount = 1;
+        writeDescriptorSet.descriptorType = descriptorType.type;
+        if (slot.binding == Binding::StorageBuffer)
+            writeDescriptorSet.pBufferInfo = &descriptorInfos[i].descrBuffInfo;
+        else
+            writeDescriptorSet.pImageInfo = &descriptorInfos[i].descrImgInfo;
+    }
+    m_device->updateDescriptorSets(writeDescriptorSets, nullptr, m_device->dld());
+
+    m_objects[{slot.binding, slot.index}] = move(objects);
+
+    return slot;
+}
+void BindlessTable::remove(const Slot &slot)
+{
+    vector<shared_ptr<MemoryObjectBase>> objects;
+
+    {
+        lock_guard<mutex> locker(m_mutex);
+        auto it = m_objects.find({slot.binding, slot.index});
+        if (it == m_objects.end())
+            return;
+        objects = move(it->second);
+        m_objects.erase(it);
+    }
+
+    // Descriptors can still be used by submitted command buffers, the callback can be called immediately
+    m_device->deferRelease([weakThis = weak_from_this(), slot, objects = move(objects)] {
+        if (auto bindlessTable = weakThis.lock())
+            bindlessTable->freeIndices(slot);
+    });
+}
+
+BindlessTable::Binding BindlessTable::getBinding(vk::DescriptorType descriptorType)
+{
+    for (uint32_t i = 0; i < size(g_descriptorTypes); ++i)
+    {
+        if (g_descriptorTypes[i] == descriptorType)
+            return static_cast<Binding>(i);
+    }
+    throw vk::LogicError("Unsupported descriptor type for bindless table: " + vk::to_string(descriptorType));
+}
+
+uint32_t BindlessTable::allocateIndices(Binding binding, uint32_t count)
+{
+    auto &usedIndices = m_usedIndices[static_cast<uint32_t>(binding)];
+
+    // First fit, the table is small enough for a linear search
+    uint32_t freeCount = 0;
+    for (uint32_t i = 0; i < usedIndices.size(); ++i)
+    {
+        freeCount = usedIndices[i] ? 0 : freeCount + 1;
+        if (freeCount == count)
+        {
+            const uint32_t index = i + 1 - count;
+            fill_n(usedIndices.begin() + index, count, true);
+            return index;
+        }
+    }
+
+    throw vk::LogicError("Bindless table is full");
+}
+void BindlessTable::freeIndices(const Slot &slot)
+{
+    lock_guard<mutex> locker(m_mutex);
+    auto &usedIndices = m_usedIndices[static_cast<uint32_t>(slot.binding)];
+    fill_n(usedIndices.begin() + slot.index, slot.count, false);
+}
+
+}
@@ -0,0 +1,134 @@
+// SPDX-License-Identifier: MIT
+/*
+   QmVk - simple Vulkan library created for QMPlay2
+   Copyright (C) 2020-2025 Błażej Szczygieł
+*/
+
+#pragma once
+
+#include "QmVkExport.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <memory>
+#include <mutex>
+#include <map>
+
+namespace QmVk {
+
+using namespace std;
+
+class Device;
+class MemoryObjectDescr;
+class MemoryObjectBase;
+
+/*
+ * Global descriptor table for bindless access, requires descriptor indexing.
+ * Memory objects are registered once and get a stable index in the array of
+ * their descriptor type, shaders access them by the index, e.g. passed in
+ * push constants. The table is bound as descriptor set 1 by pipelines which
+ * use it, see "Pipeline::setBindlessTable()".
+ *
+ * Objects aren't transitioned by the table, so images must be in a proper
+ * layout before use, e.g. by "Pipeline::prepareObjects()".
+ */
+class QMVK_EXPORT BindlessTable : public enable_shared_from_this<BindlessTable>
+{
+public:
+    // Binding numbers in the descriptor set
+    enum class Binding : uint32_t
+    {
+        CombinedImageSampler,
+        SampledImage,
+        StorageImage,
+        StorageBuffer,
+
+        Count
+    };
+
+    struct CreateInfo
+    {
+        // Counts are clamped to device limits
+        uint32_t combinedImageSamplers = 4096;
+        uint32_t sampledImages = 1024;
+        uint32_t storageImages = 256;
+        uint32_t storageBuffers = 1024;
+    };
+
+    struct Slot
+    {
+        Binding binding = Binding::Count;
+        uint32_t index = 0; // index of the first descriptor in the binding array
+        uint32_t count = 0; // e.g. number of image planes
+    };
+
+public:
+    static shared_ptr<BindlessTable> create(
+        const shared_ptr<Device> &device,
+        const CreateInfo &createInfo = CreateInfo()
+    );
+
+public:
+    BindlessTable(
+        const shared_ptr<Device> &device
+    );
+    ~BindlessTable();
+
+private:
+    void init(const CreateInfo &createInfo);
+
+public:
+    inline shared_ptr<Device> device() const;
+
+    inline uint32_t capacity(Binding binding) const;
+
+    inline vk::DescriptorSetLayout descriptorSetLayout() const;
+    inline vk::DescriptorSet descriptorSet() const;
+
+    // Writes descriptors to free consecutive indices and keeps the objects alive until removed
+    Slot add(const MemoryObjectDescr &memoryObjectDescr);
+    // Indices are reused once the GPU finishes all currently submitted work
+    void remove(const Slot &slot);
+
+private:
+    static Binding getBinding(vk::DescriptorType descriptorType);
+
+    uint32_t allocateIndices(Binding binding, uint32_t count);
+    void freeIndices(const Slot &slot);
+
+private:
+    const shared_ptr<Device> m_device;
+
+    uint32_t m_capacities[static_cast<uint32_t>(Binding::Count)] = {};
+
+    vk::UniqueDescriptorSetLayout m_descriptorSetLayout;
+    vk::UniqueDescriptorPool m_descriptorPool;
+    vk::DescriptorSet m_descriptorSet;
+
+    mutex m_mutex;
+    vector<bool> m_usedIndices[static_cast<uint32_t>(Binding::Count)];
+    map<pair<Binding, uint32_t>, vector<shared_ptr<MemoryObjectBase>>> m_objects;
+};
+
+/* Inline implementation */
+
+shared_ptr<Device> BindlessTable::device() const
+{
+    return m_device;
+}
+
+uint32_t BindlessTable::capacity(Binding binding) const
+{
+    return m_capacities[static_cast<uint32_t>(binding)];
+}
+
+vk::DescriptorSetLayout BindlessTable::descriptorSetLayout() const
+{
+    return *m_descriptorSetLayout;
+}
+vk::DescriptorSet BindlessTable::descriptorSet() const
+{
+    return m_descriptorSet;
+}
+
+}
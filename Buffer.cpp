@@ -8,6 +8,7 @@
 #include "Device.hpp"
 #include "MemoryPropertyFlags.hpp"
 #include "CommandBuffer.hpp"
+#include "BarrierBatch.hpp"
 
 namespace QmVk {
 
@@ -96,7 +97,8 @@ shared_ptr<Buffer> Buffer::createFromDeviceMemory(
     vk::BufferUsageFlags usage,
     vk::DeviceMemory deviceMemory,
     vk::MemoryPropertyFlags memoryPropertyFlags,
-    vk::UniqueBuffer *bufferIn)
+    vk::UniqueBuffer *bufferIn,
+    vk::DeviceSize deviceMemoryOffset)
 {
     auto buffer = make_shared<Buffer>(
         device,
@@ -105,6 +107,7 @@ shared_ptr<Buffer> Buffer::createFromDeviceMemory(
     );
     buffer->m_memoryPropertyFlags = memoryPropertyFlags;
     buffer->m_deviceMemory.push_back(deviceMemory);
+    buffer->m_deviceMemoryOffset = deviceMemoryOffset;
     buffer->m_dontFreeMemory = true;
     if (bufferIn)
         buffer->m_buffer = move(*bufferIn);
@@ -125,6 +128,12 @@ Buffer::~Buffer()
     unmap();
     if (m_dontFreeMemory)
         m_deviceMemory.clear();
+    if (m_buffer)
+    {
+        m_device->deferRelease([device = m_device.get(), buffer = m_buffer.release()] {
+            device->destroyBuffer(buffer, device->allocationCallbacks(), device->dld());
+        });
+    }
 }
 
 void Buffer::init(const MemoryPropertyFlags *userMemoryPropertyFlags)
@@ -136,6 +145,16 @@ void Buffer::init(const MemoryPropertyFlags *userMemoryPropertyFlags)
         vk::BufferCreateInfo bufferCreateInfo;
         bufferCreateInfo.size = m_size;
         bufferCreateInfo.usage = m_usage;
+        if (userMemoryPropertyFlags && m_device->hasBufferDeviceAddress())
+        {
+            // Requested by the usage, or needed to write uniform and storage buffers into descriptor buffers
+            m_hasDeviceAddress =
+                (m_usage & vk::BufferUsageFlagBits::eShaderDeviceAddress) ||
+                (m_device->hasDescriptorBuffer() && (m_usage & (vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer)))
+            ;
+            if (m_hasDeviceAddress)
+                bufferCreateInfo.usage |= vk::BufferUsageFlagBits::eShaderDeviceAddress;
+        }
         if (enabledQueues.size() > 1)
         {
             bufferCreateInfo.sharingMode = vk::SharingMode::eConcurrent;
@@ -143,14 +162,14 @@ void Buffer::init(const MemoryPropertyFlags *userMemoryPropertyFlags)
             bufferCreateInfo.pQueueFamilyIndices = enabledQueues.data();
         }
 
-        m_buffer = m_device->createBufferUnique(bufferCreateInfo, nullptr, dld());
+        m_buffer = m_device->createBufferUnique(bufferCreateInfo, m_device->allocationCallbacks(), dld());
     }
 
     m_memoryRequirements = m_device->getBufferMemoryRequirements(*this, dld());
     if (userMemoryPropertyFlags && m_deviceMemory.empty())
-        allocateMemory(*userMemoryPropertyFlags);
+        allocateMemory(*userMemoryPropertyFlags, true, nullptr, m_hasDeviceAddress);
 
-    m_device->bindBufferMemory(*this, deviceMemory(), 0, dld());
+    m_device->bindBufferMemory(*this, deviceMemory(), deviceMemoryOffset(), dld());
 }
 
 void Buffer::copyTo(
@@ -172,16 +191,22 @@ void Buffer::copyTo(
     }
 
     auto copyCommands = [&](vk::CommandBuffer commandBuffer) {
+        BarrierBatch barrierBatch(commandBuffer, *m_device);
         pipelineBarrier(
-            commandBuffer,
+            barrierBatch,
             vk::PipelineStageFlagBits::eTransfer,
-            vk::AccessFlagBits::eTransferRead
+            vk::AccessFlagBits::eTransferRead,
+            vk::PipelineStageFlagBits2::eCopy,
+            vk::AccessFlagBits2::eTransferRead
         );
         dstBuffer->pipelineBarrier(
-            commandBuffer,
+            barrierBatch,
             vk::PipelineStageFlagBits::eTransfer,
-            vk::AccessFlagBits::eTransferWrite
+            vk::AccessFlagBits::eTransferWrite,
+            vk::PipelineStageFlagBits2::eCopy,
+            vk::AccessFlagBits2::eTransferWrite
         );
+        barrierBatch.flush();
 
         if (bufferCopyIn)
         {
@@ -213,7 +238,7 @@ void Buffer::copyTo(
     }
     else
     {
-        internalCommandBuffer()->execute(copyCommands);
+        executeInternal(copyCommands, {shared_from_this(), dstBuffer});
     }
 }
 
@@ -230,11 +255,15 @@ void Buffer::fill(
         throw vk::LogicError("Buffer overflow");
 
     auto fillCommands = [&](vk::CommandBuffer commandBuffer) {
+        BarrierBatch barrierBatch(commandBuffer, *m_device);
         pipelineBarrier(
-            commandBuffer,
+            barrierBatch,
             vk::PipelineStageFlagBits::eTransfer,
-            vk::AccessFlagBits::eTransferWrite
+            vk::AccessFlagBits::eTransferWrite,
+            vk::PipelineStageFlagBits2::eClear,
+            vk::AccessFlagBits2::eTransferWrite
         );
+        barrierBatch.flush();
         commandBuffer.fillBuffer(*m_buffer, offset, size, value, dld());
     };
 
@@ -245,14 +274,24 @@ void Buffer::fill(
     }
     else
     {
-        internalCommandBuffer()->execute(fillCommands);
+        executeInternal(fillCommands, {shared_from_this()});
     }
 }
 
+vk::DeviceAddress Buffer::deviceAddress() const
+{
+    if (!m_hasDeviceAddress)
+        throw vk::LogicError("Buffer has no device address");
+
+    return m_device->getBufferAddress(vk::BufferDeviceAddressInfo(*m_buffer), dld());
+}
+
 void *Buffer::map()
 {
+    flushTransferBatch();
+
     if (!m_mapped)
-        m_mapped = m_device->mapMemory(deviceMemory(), 0, memorySize(), {}, dld());
+        m_mapped = mapDeviceMemory();
 
     return m_mapped;
 }
@@ -261,7 +300,7 @@ void Buffer::unmap()
     if (!m_mapped)
         return;
 
-    m_device->unmapMemory(deviceMemory(), dld());
+    unmapDeviceMemory();
     m_mapped = nullptr;
 }
 
@@ -280,6 +319,17 @@ void Buffer::pipelineBarrier(
     vk::CommandBuffer commandBuffer,
     vk::PipelineStageFlags dstStage,
     vk::AccessFlags dstAccessFlags)
+{
+    BarrierBatch barrierBatch(commandBuffer, *m_device);
+    pipelineBarrier(barrierBatch, dstStage, dstAccessFlags);
+    barrierBatch.flush();
+}
+void Buffer::pipelineBarrier(
+    BarrierBatch &barrierBatch,
+    vk::PipelineStageFlags dstStage,
+    vk::AccessFlags dstAccessFlags,
+    vk::PipelineStageFlags2 dstStage2,
+    vk::AccessFlags2 dstAccessFlags2)
 {
     if (!mustExecPipelineBarrier(dstStage, dstAccessFlags))
         return;
@@ -293,19 +343,15 @@ void Buffer::pipelineBarrier(
         0,
         size()
     );
-    commandBuffer.pipelineBarrier(
-        m_stage,
-        dstStage,
-        vk::DependencyFlags(),
-        0,
-        nullptr,
-        1,
-        &barrier,
-        0,
-        nullptr,
-        dld()
-    );
 
+    BarrierBatch::Masks2 masks2;
+    masks2.dstStage = dstStage2;
+    masks2.dstAccess = dstAccessFlags2;
+    m_state2.setSrc(masks2, m_stage, m_accessFlags);
+
+    barrierBatch.addBufferBarrier(m_stage, dstStage, barrier, masks2);
+
+    m_state2.setDst(masks2, dstStage, dstAccessFlags);
     m_stage = dstStage;
     m_accessFlags = dstAccessFlags;
 }
@@ -9,6 +9,7 @@
 #include "QmVkExport.hpp"
 
 #include "MemoryObject.hpp"
+#include "BarrierBatch.hpp"
 
 namespace QmVk {
 
@@ -50,7 +51,8 @@ public:
         vk::BufferUsageFlags usage,
         vk::DeviceMemory deviceMemory,
         vk::MemoryPropertyFlags memoryPropertyFlags,
-        vk::UniqueBuffer *bufferIn = nullptr
+        vk::UniqueBuffer *bufferIn = nullptr,
+        vk::DeviceSize deviceMemoryOffset = 0
     );
 
 public:
@@ -81,6 +83,10 @@ public:
         const shared_ptr<CommandBuffer> &externalCommandBuffer = nullptr
     );
 
+    // Available if buffer device address is enabled, the memory is allocated by the buffer and the usage has
+    // "eShaderDeviceAddress" (implied for uniform and storage buffers if descriptor buffer is enabled)
+    vk::DeviceAddress deviceAddress() const;
+
     void *map();
     template<typename T>
     inline T *map();
@@ -103,12 +109,20 @@ private:
         vk::PipelineStageFlags dstStage,
         vk::AccessFlags dstAccessFlags
     );
+    void pipelineBarrier(
+        BarrierBatch &barrierBatch,
+        vk::PipelineStageFlags dstStage,
+        vk::AccessFlags dstAccessFlags,
+        vk::PipelineStageFlags2 dstStage2 = {},
+        vk::AccessFlags2 dstAccessFlags2 = {}
+    );
 
 private:
     const vk::DeviceSize m_size;
     const vk::BufferUsageFlags m_usage;
 
     vk::UniqueBuffer m_buffer;
+    bool m_hasDeviceAddress = false;
 
     void *m_mapped = nullptr;
 
@@ -116,6 +130,7 @@ private:
 
     vk::PipelineStageFlags m_stage = vk::PipelineStageFlagBits::eTopOfPipe;
     vk::AccessFlags m_accessFlags;
+    BarrierBatch::State2 m_state2;
 };
 
 /* Inline implementation */
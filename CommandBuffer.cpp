@@ -7,8 +7,10 @@
 #include "CommandBuffer.hpp"
 #include "Device.hpp"
 #include "Queue.hpp"
+#include "Completion.hpp"
 #include "DescriptorSet.hpp"
 #include "MemoryObjectDescrs.hpp"
+#include "TransferBatch.hpp"
 
 #include <unordered_set>
 
@@ -36,7 +38,20 @@ CommandBuffer::CommandBuffer(
     , m_dld(m_queue->dld())
 {}
 CommandBuffer::~CommandBuffer()
-{}
+{
+    // Command buffer can't be freed while it's still executing
+    if (m_pendingCompletion)
+    {
+        try
+        {
+            m_pendingCompletion->wait();
+        }
+        catch (...)
+        {
+            // E.g. device lost, nothing is executing anymore
+        }
+    }
+}
 
 void CommandBuffer::init()
 {
@@ -45,7 +60,7 @@ void CommandBuffer::init()
     vk::CommandPoolCreateInfo commandPoolCreateInfo;
     commandPoolCreateInfo.flags = vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
     commandPoolCreateInfo.queueFamilyIndex = m_queue->queueFamilyIndex();
-    m_commandPool = device->createCommandPoolUnique(commandPoolCreateInfo, nullptr, dld());
+    m_commandPool = device->createCommandPoolUnique(commandPoolCreateInfo, device->allocationCallbacks(), dld());
 
     vk::CommandBufferAllocateInfo commandBufferAllocateInfo;
     commandBufferAllocateInfo.commandPool = *m_commandPool;
@@ -57,11 +72,16 @@ void CommandBuffer::init()
 void CommandBuffer::storeData(
     const MemoryObjectDescrs &memoryObjects,
     const shared_ptr<DescriptorSet> &descriptorSet)
+{
+    storeData(memoryObjects);
+    m_storedData->descriptorSets.insert(descriptorSet);
+}
+void CommandBuffer::storeData(
+    const MemoryObjectDescrs &memoryObjects)
 {
     if (!m_storedData)
         m_storedData = make_unique<StoredData>();
 
-    m_storedData->descriptorSets.insert(descriptorSet);
     memoryObjects.iterateMemoryObjects([this](const shared_ptr<MemoryObjectBase> &object) {
         m_storedData->memoryObjectsBase.insert(object);
     });
@@ -87,6 +107,7 @@ void CommandBuffer::resetAndBegin()
 {
     if (m_resetNeeded)
     {
+        waitForPendingCompletion();
         reset(vk::CommandBufferResetFlags(), dld());
         resetStoredData();
     }
@@ -102,9 +123,27 @@ void CommandBuffer::endSubmitAndWait(
     bool lock,
     const Callback &callback,
     vk::SubmitInfo &&submitInfo)
+{
+    submitAsync(lock, callback, move(submitInfo));
+    waitForPendingCompletion();
+}
+
+shared_ptr<Completion> CommandBuffer::submitAsync(
+    vk::SubmitInfo &&submitInfo,
+    const Callback &completionCallback)
+{
+    return submitAsync(true, nullptr, move(submitInfo), completionCallback);
+}
+shared_ptr<Completion> CommandBuffer::submitAsync(
+    bool lock,
+    const Callback &callback,
+    vk::SubmitInfo &&submitInfo,
+    const Callback &completionCallback)
 {
     unique_lock<mutex> queueLock;
 
+    flushTransferBatch(!lock);
+
     end(dld());
 
     if (lock)
@@ -112,14 +151,78 @@ void CommandBuffer::endSubmitAndWait(
 
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &*this;
-    m_queue->submitCommandBuffer(move(submitInfo));
+    auto completion = m_queue->submitCommandBuffer(move(submitInfo));
+
+    setPendingCompletion(completion, completionCallback);
 
     if (callback)
         callback();
 
-    m_queue->waitForCommandsFinished();
+    if (lock)
+    {
+        queueLock.unlock();
+        m_queue->collectCompletions();
+    }
+
+    return completion;
+}
+shared_ptr<Completion> CommandBuffer::submitAsync(
+    vk::SubmitInfo2 &&submitInfo,
+    const Callback &completionCallback)
+{
+    flushTransferBatch(false);
+
+    end(dld());
+
+    vk::CommandBufferSubmitInfo commandBufferInfo;
+    commandBufferInfo.commandBuffer = *this;
+
+    submitInfo.commandBufferInfoCount = 1;
+    submitInfo.pCommandBufferInfos = &commandBufferInfo;
+
+    auto queueLock = m_queue->lock();
+    auto completion = m_queue->submitCommandBuffer(move(submitInfo));
+    queueLock.unlock();
+
+    setPendingCompletion(completion, completionCallback);
+
+    m_queue->collectCompletions();
+
+    return completion;
+}
+
+void CommandBuffer::flushTransferBatch(bool queueLocked)
+{
+    // Commands in this buffer can depend on the state set by pending internal transfers
+    if (auto transferBatch = m_queue->device()->transferBatch())
+        transferBatch->flushBeforeSubmit(this, queueLocked);
+}
 
-    resetStoredData();
+void CommandBuffer::setPendingCompletion(
+    const shared_ptr<Completion> &completion,
+    const Callback &completionCallback)
+{
+    if (m_storedData)
+        completion->keepAlive(shared_ptr<StoredData>(move(m_storedData)));
+    completion->addCallback(completionCallback);
+
+    m_pendingCompletion = completion;
+}
+
+void CommandBuffer::waitForPendingCompletion()
+{
+    if (!m_pendingCompletion)
+        return;
+
+    const bool finished = m_pendingCompletion->wait(
+#ifdef QMVK_WAIT_TIMEOUT_MS
+        QMVK_WAIT_TIMEOUT_MS * static_cast<uint64_t>(1e6)
+#endif
+    );
+    if (!finished)
+        throw vk::SystemError(vk::make_error_code(vk::Result::eTimeout), "vkWaitForFences");
+
+    m_pendingCompletion.reset();
 }
 
 void CommandBuffer::execute(const CommandCallback &callback)
@@ -129,4 +232,35 @@ void CommandBuffer::execute(const CommandCallback &callback)
     endSubmitAndWait();
 }
 
+#ifndef QMVK_NO_GRAPHICS
+void CommandBuffer::beginDynamicRendering(
+    vk::ImageView imageView,
+    const vk::Extent2D &size,
+    vk::AttachmentLoadOp loadOp,
+    const vk::ClearColorValue &clearColor)
+{
+    if (!m_queue->device()->hasDynamicRendering())
+        throw vk::LogicError("Dynamic rendering is not enabled");
+
+    vk::RenderingAttachmentInfo colorAttachment;
+    colorAttachment.imageView = imageView;
+    colorAttachment.imageLayout = vk::ImageLayout::eColorAttachmentOptimal;
+    colorAttachment.loadOp = loadOp;
+    colorAttachment.storeOp = vk::AttachmentStoreOp::eStore;
+    colorAttachment.clearValue.color = clearColor;
+
+    vk::RenderingInfo renderingInfo;
+    renderingInfo.renderArea.extent = size;
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachments = &colorAttachment;
+
+    beginRendering(renderingInfo, m_dld);
+}
+void CommandBuffer::endDynamicRendering()
+{
+    endRendering(m_dld);
+}
+#endif
+
 }
@@ -20,6 +20,7 @@ using namespace std;
 class MemoryObjectDescrs;
 class MemoryObjectBase;
 class DescriptorSet;
+class Completion;
 class Queue;
 
 class QMVK_EXPORT CommandBuffer : public vk::CommandBuffer
@@ -52,6 +53,10 @@ public:
         const MemoryObjectDescrs &memoryObjects,
         const shared_ptr<DescriptorSet> &descriptorSet
     );
+    // Without a descriptor set, e.g. for push descriptors
+    void storeData(
+        const MemoryObjectDescrs &memoryObjects
+    );
     void storeData(
         const shared_ptr<MemoryObjectBase> &memoryObjectBase
     );
@@ -67,8 +72,48 @@ public:
         vk::SubmitInfo &&submitInfo
     );
 
+    // Stored data is kept alive until the returned completion signals
+    shared_ptr<Completion> submitAsync(
+        vk::SubmitInfo &&submitInfo = vk::SubmitInfo(),
+        const Callback &completionCallback = nullptr
+    );
+    shared_ptr<Completion> submitAsync(
+        bool lock,
+        const Callback &callback,
+        vk::SubmitInfo &&submitInfo,
+        const Callback &completionCallback = nullptr
+    );
+    // Requires synchronization2
+    shared_ptr<Completion> submitAsync(
+        vk::SubmitInfo2 &&submitInfo,
+        const Callback &completionCallback = nullptr
+    );
+
+    inline shared_ptr<Completion> pendingCompletion() const;
+    void waitForPendingCompletion();
+
     void execute(const CommandCallback &callback);
 
+#ifndef QMVK_NO_GRAPHICS
+    // Renders directly to the image view without a render pass, requires dynamic rendering.
+    // The image must be in "eColorAttachmentOptimal" layout.
+    void beginDynamicRendering(
+        vk::ImageView imageView,
+        const vk::Extent2D &size,
+        vk::AttachmentLoadOp loadOp = vk::AttachmentLoadOp::eLoad,
+        const vk::ClearColorValue &clearColor = {}
+    );
+    void endDynamicRendering();
+#endif
+
+private:
+    void flushTransferBatch(bool queueLocked);
+
+    void setPendingCompletion(
+        const shared_ptr<Completion> &completion,
+        const Callback &completionCallback
+    );
+
 private:
     const shared_ptr<Queue> m_queue;
     const vk::detail::DispatchLoaderDynamic &m_dld;
@@ -77,6 +122,8 @@ private:
 
     unique_ptr<StoredData> m_storedData;
     bool m_resetNeeded = false;
+
+    shared_ptr<Completion> m_pendingCompletion;
 };
 
 /* Inline implementation */
@@ -90,4 +137,9 @@ const vk::detail::DispatchLoaderDynamic &CommandBuffer::dld() const
     return m_dld;
 }
 
+shared_ptr<Completion> CommandBuffer::pendingCompletion() const
+{
+    return m_pendingCompletion;
+}
+
 }
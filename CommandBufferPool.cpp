@@ -0,0 +1,164 @@
+// SPDX-License-Identifier: MIT
+/*
+   QmVk - simple Vulkan library created for QMPlay2
+   Copyright (C) 2020-2025 Błażej Szczygieł
+*/
+
+#include "CommandBufferPool.hpp"
+#include "Device.hpp"
+#include "Queue.hpp"
+
+#include <algorithm>
+
+namespace QmVk {
+
+struct CommandBufferPool::ThreadPool
+{
+    vk::CommandPool commandPool;
+    vector<vk::CommandBuffer> freeCommandBuffers;
+};
+
+struct CommandBufferPool::Pools
+{
+    Device *device; // null when the device pool is destroyed
+
+    mutex poolsMutex;
+    map<pair<thread::id, uint32_t>, unique_ptr<ThreadPool>> threadPools;
+};
+
+// Destroys pools of the thread when it exits, thread ids can be reused
+struct CommandBufferPool::ThreadOwner
+{
+    ~ThreadOwner();
+
+    vector<weak_ptr<Pools>> pools;
+};
+
+CommandBufferPool::ThreadOwner::~ThreadOwner()
+{
+    const auto threadId = this_thread::get_id();
+    for (auto &&weakPools : pools)
+    {
+        if (auto pools = weakPools.lock())
+            destroyThreadPools(*pools, threadId);
+    }
+}
+
+CommandBufferPool::CommandBufferPool(Device &device)
+    : m_device(device)
+    , m_pools(make_shared<Pools>())
+{
+    m_pools->device = &m_device;
+}
+CommandBufferPool::~CommandBufferPool()
+{
+    lock_guard<mutex> locker(m_pools->poolsMutex);
+
+    for (auto &&threadPool : m_pools->threadPools)
+        m_device.destroyCommandPool(threadPool.second->commandPool, m_device.allocationCallbacks(), m_device.dld());
+    m_pools->threadPools.clear();
+    m_pools->device = nullptr;
+}
+
+vk::CommandBuffer CommandBufferPool::acquire(uint32_t queueFamilyIndex)
+{
+    lock_guard<mutex> locker(m_pools->poolsMutex);
+
+    auto &threadPool = getThreadPool(queueFamilyIndex);
+
+    if (!threadPool.freeCommandBuffers.empty())
+    {
+        auto commandBuffer = threadPool.freeCommandBuffers.back();
+        threadPool.freeCommandBuffers.pop_back();
+        return commandBuffer;
+    }
+
+    vk::CommandBufferAllocateInfo commandBufferAllocateInfo;
+    commandBufferAllocateInfo.commandPool = threadPool.commandPool;
+    commandBufferAllocateInfo.level = vk::CommandBufferLevel::ePrimary;
+    commandBufferAllocateInfo.commandBufferCount = 1;
+    return m_device.allocateCommandBuffers(commandBufferAllocateInfo, m_device.dld())[0];
+}
+void CommandBufferPool::release(uint32_t queueFamilyIndex, vk::CommandBuffer commandBuffer)
+{
+    lock_guard<mutex> locker(m_pools->poolsMutex);
+    getThreadPool(queueFamilyIndex).freeCommandBuffers.push_back(commandBuffer);
+}
+
+void CommandBufferPool::execute(
+    const shared_ptr<Queue> &queue,
+    const function<void(vk::CommandBuffer)> &callback)
+{
+    const auto queueFamilyIndex = queue->queueFamilyIndex();
+    const auto &dld = m_device.dld();
+
+    // On exception the command buffer is not returned to the pool, it will be freed with the pool
+    auto commandBuffer = acquire(queueFamilyIndex);
+
+    commandBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit), dld);
+    callback(commandBuffer);
+    commandBuffer.end(dld);
+
+    {
+        auto queueLock = queue->lock();
+
+        vk::SubmitInfo submitInfo;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        queue->submitCommandBuffer(move(submitInfo));
+
+        queue->waitForCommandsFinished();
+    }
+
+    release(queueFamilyIndex, commandBuffer);
+}
+
+CommandBufferPool::ThreadPool &CommandBufferPool::getThreadPool(uint32_t queueFamilyIndex)
+{
+    auto &threadPool = m_pools->threadPools[{this_thread::get_id(), queueFamilyIndex}];
+    if (!threadPool)
+    {
+        vk::CommandPoolCreateInfo commandPoolCreateInfo;
+        commandPoolCreateInfo.flags = vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+        commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+
+        auto newThreadPool = make_unique<ThreadPool>();
+        newThreadPool->commandPool = m_device.createCommandPool(commandPoolCreateInfo, m_device.allocationCallbacks(), m_device.dld());
+        threadPool = move(newThreadPool);
+
+        static thread_local ThreadOwner threadOwner;
+        auto &pools = threadOwner.pools;
+        pools.erase(remove_if(pools.begin(), pools.end(), [](auto &&weakPools) {
+            return weakPools.expired();
+        }), pools.end());
+        const bool registered = any_of(pools.begin(), pools.end(), [this](auto &&weakPools) {
+            return (weakPools.lock() == m_pools);
+        });
+        if (!registered)
+            pools.push_back(m_pools);
+    }
+    return *threadPool;
+}
+
+void CommandBufferPool::destroyThreadPools(Pools &pools, thread::id threadId)
+{
+    lock_guard<mutex> locker(pools.poolsMutex);
+
+    if (!pools.device)
+        return;
+
+    for (auto it = pools.threadPools.begin(); it != pools.threadPools.end();)
+    {
+        if (it->first.first == threadId)
+        {
+            pools.device->destroyCommandPool(it->second->commandPool, pools.device->allocationCallbacks(), pools.device->dld());
+            it = pools.threadPools.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+}
@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: MIT
+/*
+   QmVk - simple Vulkan library created for QMPlay2
+   Copyright (C) 2020-2025 Błażej Szczygieł
+*/
+
+#pragma once
+
+#include "QmVkExport.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <functional>
+#include <thread>
+#include <memory>
+#include <mutex>
+#include <map>
+
+namespace QmVk {
+
+using namespace std;
+
+class Device;
+class Queue;
+
+/*
+ * Per-device pool of reusable command buffers for internal one-shot
+ * operations. Every thread gets its own VkCommandPool for each queue
+ * family, so recording doesn't need any locking. Pools of a thread are
+ * destroyed when the thread exits, so command buffers must not be used
+ * outside of the thread which acquired them.
+ */
+class QMVK_EXPORT CommandBufferPool
+{
+    struct ThreadPool;
+    struct Pools;
+    struct ThreadOwner;
+
+public:
+    CommandBufferPool(Device &device);
+    ~CommandBufferPool();
+
+public:
+    vk::CommandBuffer acquire(uint32_t queueFamilyIndex);
+    void release(uint32_t queueFamilyIndex, vk::CommandBuffer commandBuffer);
+
+    // Records the commands, submits them to the queue and waits for completion
+    void execute(
+        const shared_ptr<Queue> &queue,
+        const function<void(vk::CommandBuffer)> &callback
+    );
+
+private:
+    ThreadPool &getThreadPool(uint32_t queueFamilyIndex);
+
+    static void destroyThreadPools(Pools &pools, thread::id threadId);
+
+private:
+    Device &m_device;
+
+    const shared_ptr<Pools> m_pools; // referenced by each thread which uses it
+};
+
+}
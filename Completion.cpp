@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: MIT
+/*
+   QmVk - simple Vulkan library created for QMPlay2
+   Copyright (C) 2020-2025 Błażej Szczygieł
+*/
+
+#include "Completion.hpp"
+#include "Device.hpp"
+#include "Queue.hpp"
+
+namespace QmVk {
+
+shared_ptr<Completion> Completion::create(
+    const shared_ptr<Device> &device,
+    const weak_ptr<Queue> &queue,
+    vk::Fence fence)
+{
+    return make_shared<Completion>(
+        device,
+        queue,
+        fence
+    );
+}
+
+Completion::Completion(
+    const shared_ptr<Device> &device,
+    const weak_ptr<Queue> &queue,
+    vk::Fence fence)
+    : m_device(device)
+    , m_queue(queue)
+    , m_fence(fence)
+{}
+Completion::~Completion()
+{
+    try
+    {
+        // The fence and the kept alive data can't be destroyed while in use
+        if (m_submitted && !m_done)
+            wait();
+
+        if (auto queue = m_queue.lock())
+        {
+            queue->recycleFence(m_fence);
+            return;
+        }
+    }
+    catch (...)
+    {
+        // E.g. device lost, the fence can't be reused
+    }
+    m_device->destroyFence(m_fence, m_device->allocationCallbacks(), m_device->dld());
+}
+
+bool Completion::isDone()
+{
+    if (m_done)
+        return true;
+
+    if (m_device->getFenceStatus(m_fence, m_device->dld()) != vk::Result::eSuccess)
+        return false;
+
+    finish();
+    return true;
+}
+bool Completion::wait(uint64_t timeout)
+{
+    if (m_done)
+        return true;
+
+    auto result = m_device->waitForFences(
+        m_fence,
+        true,
+        timeout,
+        m_device->dld()
+    );
+    if (result == vk::Result::eTimeout)
+        return false;
+
+    finish();
+    return true;
+}
+
+void Completion::addCallback(const Callback &callback)
+{
+    if (!callback)
+        return;
+
+    unique_lock<mutex> locker(m_mutex);
+    if (!m_done)
+    {
+        m_callbacks.push_back(callback);
+        return;
+    }
+    locker.unlock();
+
+    callback();
+}
+void Completion::keepAlive(const shared_ptr<void> &data)
+{
+    lock_guard<mutex> locker(m_mutex);
+    if (!m_done)
+        m_keepAlive.push_back(data);
+}
+
+void Completion::finish()
+{
+    vector<Callback> callbacks;
+    vector<shared_ptr<void>> keepAlive;
+
+    {
+        lock_guard<mutex> locker(m_mutex);
+        if (m_done)
+            return;
+
+        m_done = true;
+        swap(callbacks, m_callbacks);
+        swap(keepAlive, m_keepAlive);
+    }
+
+    keepAlive.clear();
+    for (auto &&callback : callbacks)
+        callback();
+}
+
+}
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: MIT
+/*
+   QmVk - simple Vulkan library created for QMPlay2
+   Copyright (C) 2020-2025 Błażej Szczygieł
+*/
+
+#pragma once
+
+#include "QmVkExport.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <functional>
+#include <limits>
+#include <memory>
+#include <atomic>
+#include <mutex>
+
+namespace QmVk {
+
+using namespace std;
+
+class Device;
+class Queue;
+
+/*
+ * Handle for a single asynchronous submission. Callbacks are called and the
+ * kept alive data is released when the completion is observed by "isDone()",
+ * "wait()" or "Queue::collectCompletions()", on the observing thread. The
+ * queue collects completions on later submissions, otherwise the caller must
+ * poll.
+ */
+class QMVK_EXPORT Completion
+{
+    friend class Queue;
+
+public:
+    using Callback = function<void()>;
+
+public:
+    static shared_ptr<Completion> create(
+        const shared_ptr<Device> &device,
+        const weak_ptr<Queue> &queue,
+        vk::Fence fence
+    );
+
+public:
+    Completion(
+        const shared_ptr<Device> &device,
+        const weak_ptr<Queue> &queue,
+        vk::Fence fence
+    );
+    ~Completion();
+
+public:
+    inline vk::Fence fence() const;
+
+    bool isDone();
+    // Returns false on timeout, the timeout is in nanoseconds
+    bool wait(uint64_t timeout = numeric_limits<uint64_t>::max());
+
+    void addCallback(const Callback &callback);
+    void keepAlive(const shared_ptr<void> &data);
+
+private:
+    void finish();
+
+private:
+    const shared_ptr<Device> m_device;
+    const weak_ptr<Queue> m_queue;
+    const vk::Fence m_fence;
+
+    mutex m_mutex;
+    atomic_bool m_submitted {false}; // set by the queue once the fence is submitted
+    atomic_bool m_done {false};
+    vector<Callback> m_callbacks;
+    vector<shared_ptr<void>> m_keepAlive;
+};
+
+/* Inline implementation */
+
+vk::Fence Completion::fence() const
+{
+    return m_fence;
+}
+
+}
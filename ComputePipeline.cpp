@@ -7,6 +7,7 @@
 #include "ComputePipeline.hpp"
 #include "PhysicalDevice.hpp"
 #include "Device.hpp"
+#include "PipelineCache.hpp"
 #include "ShaderModule.hpp"
 #include "CommandBuffer.hpp"
 
@@ -41,29 +42,76 @@ ComputePipeline::ComputePipeline(
 ComputePipeline::~ComputePipeline()
 {}
 
-void ComputePipeline::createPipeline()
+void ComputePipeline::createPipeline(const Variant &variant, vk::PipelineLayout pipelineLayout, Program &program) const
 {
-    if (m_localWorkgroupSize.width == 0 || m_localWorkgroupSize.height == 0)
-        m_localWorkgroupSize = m_device->physicalDevice()->localWorkgroupSize();
-
+    // Local workgroup size is stored in the variant data
     vector<vk::SpecializationMapEntry> specializationMapEntries;
     vector<uint32_t> specializationData {
-        m_localWorkgroupSize.width,
-        m_localWorkgroupSize.height,
+        variant.data[0],
+        variant.data[1],
         1,
     };
     vk::SpecializationInfo specializationInfo = getSpecializationInfo(
+        variant,
         vk::ShaderStageFlagBits::eCompute,
         specializationMapEntries,
         specializationData
     );
 
     vk::ComputePipelineCreateInfo pipelineCreateInfo;
+    pipelineCreateInfo.flags = variant.createFlags;
     if (m_dispatchBase)
-        pipelineCreateInfo.flags = vk::PipelineCreateFlagBits::eDispatchBase;
+        pipelineCreateInfo.flags |= vk::PipelineCreateFlagBits::eDispatchBase;
     pipelineCreateInfo.stage = m_shaderModule->getPipelineShaderStageCreateInfo(specializationInfo);
-    pipelineCreateInfo.layout = *m_pipelineLayout;
-    m_pipeline = m_device->createComputePipelineUnique(nullptr, pipelineCreateInfo, nullptr, m_dld).value;
+    pipelineCreateInfo.layout = pipelineLayout;
+
+    program.shaderStages = {vk::ShaderStageFlagBits::eCompute};
+
+    vk::PipelineCreationFeedbackCreateInfo creationFeedbackCreateInfo;
+    prepareCreationFeedback(program, creationFeedbackCreateInfo, pipelineCreateInfo.pNext);
+
+    auto pipelineCacheLock = m_device->pipelineCache()->lockShared();
+    program.pipeline = m_device->createComputePipelineUnique(*m_device->pipelineCache(), pipelineCreateInfo, m_device->allocationCallbacks(), m_dld).value;
+    addCreationFeedback(program);
+}
+Pipeline::Program ComputePipeline::createShaders(const Variant &variant, const vector<vk::DescriptorSetLayout> &setLayouts) const
+{
+    // Local workgroup size is stored in the variant data
+    vector<vk::SpecializationMapEntry> specializationMapEntries;
+    vector<uint32_t> specializationData {
+        variant.data[0],
+        variant.data[1],
+        1,
+    };
+    vk::SpecializationInfo specializationInfo = getSpecializationInfo(
+        variant,
+        vk::ShaderStageFlagBits::eCompute,
+        specializationMapEntries,
+        specializationData
+    );
+
+    vector<vk::ShaderCreateInfoEXT> shaderCreateInfos {
+        m_shaderModule->getShaderCreateInfo(specializationInfo),
+    };
+    if (m_dispatchBase)
+        shaderCreateInfos[0].flags = vk::ShaderCreateFlagBitsEXT::eDispatchBase;
+
+    return createShaderObjects(shaderCreateInfos, setLayouts);
+}
+void ComputePipeline::appendVariantData(vector<uint32_t> &variantData)
+{
+    if (m_localWorkgroupSize.width == 0 || m_localWorkgroupSize.height == 0)
+        m_localWorkgroupSize = m_device->physicalDevice()->localWorkgroupSize();
+
+    variantData.push_back(m_localWorkgroupSize.width);
+    variantData.push_back(m_localWorkgroupSize.height);
+}
+
+void ComputePipeline::fillManifestEntry(PipelineManifest::Entry &entry) const
+{
+    entry.bindPoint = vk::PipelineBindPoint::eCompute;
+    entry.dispatchBase = m_dispatchBase;
+    entry.shaderHashes = {m_shaderModule->hash()};
 }
 
 void ComputePipeline::setCustomSpecializationData(const vector<uint32_t> &data)
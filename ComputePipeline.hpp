@@ -36,7 +36,10 @@ public:
     ~ComputePipeline();
 
 private:
-    void createPipeline() override;
+    void createPipeline(const Variant &variant, vk::PipelineLayout pipelineLayout, Program &program) const override;
+    Program createShaders(const Variant &variant, const vector<vk::DescriptorSetLayout> &setLayouts) const override;
+    void fillManifestEntry(PipelineManifest::Entry &entry) const override;
+    void appendVariantData(vector<uint32_t> &variantData) override;
 
 public:
     void setCustomSpecializationData(const vector<uint32_t> &data);
@@ -0,0 +1,197 @@
+// SPDX-License-Identifier: MIT
+/*
+   QmVk - simple Vulkan library created for QMPlay2
+   Copyright (C) 2020-2025 Błażej Szczygieł
+*/
+
+#include "DescriptorAllocator.hpp"
+#include "DescriptorSetLayout.hpp"
+#include "DescriptorSet.hpp"
+#include "Device.hpp"
+
+#include <algorithm>
+
+namespace QmVk {
+
+constexpr uint32_t g_maxSetsPerPool = 4096;
+
+shared_ptr<DescriptorAllocator> DescriptorAllocator::create(
+    const shared_ptr<Device> &device,
+    uint32_t initialSetsPerPool)
+{
+    return make_shared<DescriptorAllocator>(
+        device,
+        initialSetsPerPool
+    );
+}
+
+DescriptorAllocator::DescriptorAllocator(
+    const shared_ptr<Device> &device,
+    uint32_t initialSetsPerPool)
+    : m_device(device)
+    , m_setsPerPool(max(initialSetsPerPool, 1u))
+{}
+DescriptorAllocator::~DescriptorAllocator()
+{
+    // Descriptor sets from the pools can still be used by submitted command buffers
+    for (auto &&pool : m_pools)
+    {
+        m_device->deferRelease([device = m_device.get(), descriptorPool = pool.descriptorPool.release()] {
+            device->destroyDescriptorPool(descriptorPool, device->allocationCallbacks(), device->dld());
+        });
+    }
+}
+
+shared_ptr<DescriptorSet> DescriptorAllocator::allocate(
+    const shared_ptr<DescriptorSetLayout> &descriptorSetLayout)
+{
+    return allocate(descriptorSetLayout, 1)[0];
+}
+vector<shared_ptr<DescriptorSet>> DescriptorAllocator::allocate(
+    const shared_ptr<DescriptorSetLayout> &descriptorSetLayout,
+    uint32_t count)
+{
+    if (descriptorSetLayout->mode() != DescriptorSetLayout::Mode::DescriptorSet)
+        throw vk::LogicError("Descriptor set layout doesn't support descriptor sets");
+
+    if (count == 0)
+        return {};
+
+    // Pools must fit all descriptors of a single set, bindings of the same type are summed up
+    map<vk::DescriptorType, uint32_t> layoutDescriptorCounts;
+    for (auto &&descriptorType : descriptorSetLayout->descriptorTypes())
+        layoutDescriptorCounts[descriptorType.type] += descriptorType.descriptorCount;
+
+    const vector<vk::DescriptorSetLayout> descriptorSetLayouts(count, *static_cast<const vk::DescriptorSetLayout *>(*descriptorSetLayout));
+    vector<vk::DescriptorSet> descriptorSets(count);
+
+    Allocation allocation;
+
+    {
+        lock_guard<mutex> locker(m_mutex);
+
+        bool hasNewDescriptorCounts = false;
+        for (auto &&layoutDescriptorCount : layoutDescriptorCounts)
+        {
+            auto &descriptorCount = m_descriptorCounts[layoutDescriptorCount.first];
+            if (layoutDescriptorCount.second > descriptorCount)
+            {
+                descriptorCount = layoutDescriptorCount.second;
+                hasNewDescriptorCounts = true;
+            }
+        }
+
+        bool allocated = false;
+
+        // Existing pools are most likely too small for a layout with new descriptor counts
+        if (!hasNewDescriptorCounts)
+        {
+            for (; m_currentPool < m_pools.size(); ++m_currentPool)
+            {
+                if (tryAllocate(m_currentPool, descriptorSetLayouts, descriptorSets.data()))
+                {
+                    allocated = true;
+                    break;
+                }
+            }
+        }
+
+        if (!allocated)
+        {
+            addPool(count);
+            if (!tryAllocate(m_currentPool, descriptorSetLayouts, descriptorSets.data()))
+                throw vk::LogicError("Can't allocate descriptor sets");
+        }
+
+        allocation.poolIdx = m_currentPool;
+        allocation.generation = m_pools[m_currentPool].generation;
+    }
+
+    vector<shared_ptr<DescriptorSet>> sets;
+    sets.reserve(count);
+    for (auto &&descriptorSet : descriptorSets)
+    {
+        allocation.descriptorSet = descriptorSet;
+        sets.push_back(make_shared<DescriptorSet>(
+            shared_from_this(),
+            descriptorSetLayout,
+            allocation
+        ));
+    }
+    return sets;
+}
+
+void DescriptorAllocator::reset()
+{
+    lock_guard<mutex> locker(m_mutex);
+
+    for (auto &&pool : m_pools)
+    {
+        m_device->resetDescriptorPool(*pool.descriptorPool, vk::DescriptorPoolResetFlags(), m_device->dld());
+        ++pool.generation;
+    }
+    m_currentPool = 0;
+}
+
+void DescriptorAllocator::free(const Allocation &allocation)
+{
+    lock_guard<mutex> locker(m_mutex);
+
+    auto &pool = m_pools[allocation.poolIdx];
+    if (pool.generation != allocation.generation)
+        return;
+
+    m_device->freeDescriptorSets(*pool.descriptorPool, allocation.descriptorSet, m_device->dld());
+
+    // The pool has space again
+    m_currentPool = min<size_t>(m_currentPool, allocation.poolIdx);
+}
+
+bool DescriptorAllocator::tryAllocate(
+    uint32_t poolIdx,
+    const vector<vk::DescriptorSetLayout> &descriptorSetLayouts,
+    vk::DescriptorSet *descriptorSets)
+{
+    vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo;
+    descriptorSetAllocateInfo.descriptorPool = *m_pools[poolIdx].descriptorPool;
+    descriptorSetAllocateInfo.descriptorSetCount = descriptorSetLayouts.size();
+    descriptorSetAllocateInfo.pSetLayouts = descriptorSetLayouts.data();
+
+    const auto result = m_device->allocateDescriptorSets(&descriptorSetAllocateInfo, descriptorSets, m_device->dld());
+    switch (result)
+    {
+        case vk::Result::eSuccess:
+            return true;
+        case vk::Result::eErrorOutOfPoolMemory:
+        case vk::Result::eErrorFragmentedPool:
+            return false;
+        default:
+            throw vk::SystemError(vk::make_error_code(result), "vkAllocateDescriptorSets");
+    }
+}
+void DescriptorAllocator::addPool(uint32_t minSets)
+{
+    while (m_setsPerPool < minSets)
+        m_setsPerPool *= 2;
+
+    vector<vk::DescriptorPoolSize> descriptorPoolSizes;
+    descriptorPoolSizes.reserve(m_descriptorCounts.size());
+    for (auto &&descriptorCount : m_descriptorCounts)
+        descriptorPoolSizes.emplace_back(descriptorCount.first, descriptorCount.second * m_setsPerPool);
+
+    vk::DescriptorPoolCreateInfo descriptorPoolCreateInfo;
+    descriptorPoolCreateInfo.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
+    descriptorPoolCreateInfo.maxSets = m_setsPerPool;
+    descriptorPoolCreateInfo.poolSizeCount = descriptorPoolSizes.size();
+    descriptorPoolCreateInfo.pPoolSizes = descriptorPoolSizes.data();
+
+    Pool pool;
+    pool.descriptorPool = m_device->createDescriptorPoolUnique(descriptorPoolCreateInfo, m_device->allocationCallbacks(), m_device->dld());
+    m_pools.push_back(move(pool));
+    m_currentPool = m_pools.size() - 1;
+
+    // Next pool is bigger, so the chain stays short
+    m_setsPerPool = min(m_setsPerPool * 2, max(g_maxSetsPerPool, m_setsPerPool));
+}
+
+}
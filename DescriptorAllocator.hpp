@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: MIT
+/*
+   QmVk - simple Vulkan library created for QMPlay2
+   Copyright (C) 2020-2025 Błażej Szczygieł
+*/
+
+#pragma once
+
+#include "QmVkExport.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <memory>
+#include <mutex>
+#include <map>
+
+namespace QmVk {
+
+using namespace std;
+
+class Device;
+class DescriptorSetLayout;
+class DescriptorSet;
+
+/*
+ * Allocates descriptor sets of any layout from a growing chain of large
+ * descriptor pools. Sets are freed when destroyed, or all of them at once
+ * by "reset()", e.g. for each frame in flight. Pipelines use the allocator
+ * shared by the device.
+ */
+class QMVK_EXPORT DescriptorAllocator : public enable_shared_from_this<DescriptorAllocator>
+{
+    friend class DescriptorSet;
+
+public:
+    struct Allocation
+    {
+        vk::DescriptorSet descriptorSet;
+        uint32_t poolIdx = 0;
+        uint32_t generation = 0; // the set is already freed if the pool was reset since
+    };
+
+private:
+    struct Pool
+    {
+        vk::UniqueDescriptorPool descriptorPool;
+        uint32_t generation = 0;
+    };
+
+public:
+    static shared_ptr<DescriptorAllocator> create(
+        const shared_ptr<Device> &device,
+        uint32_t initialSetsPerPool = 64
+    );
+
+public:
+    DescriptorAllocator(
+        const shared_ptr<Device> &device,
+        uint32_t initialSetsPerPool
+    );
+    ~DescriptorAllocator();
+
+public:
+    shared_ptr<DescriptorSet> allocate(
+        const shared_ptr<DescriptorSetLayout> &descriptorSetLayout
+    );
+    // Allocates all sets with a single call if possible
+    vector<shared_ptr<DescriptorSet>> allocate(
+        const shared_ptr<DescriptorSetLayout> &descriptorSetLayout,
+        uint32_t count
+    );
+
+    // All allocated descriptor sets must no longer be used by the GPU, don't call it on the device allocator
+    void reset();
+
+    inline uint32_t numPools() const;
+
+private:
+    void free(const Allocation &allocation);
+
+    bool tryAllocate(
+        uint32_t poolIdx,
+        const vector<vk::DescriptorSetLayout> &descriptorSetLayouts,
+        vk::DescriptorSet *descriptorSets
+    );
+    void addPool(uint32_t minSets);
+
+private:
+    const shared_ptr<Device> m_device;
+
+    mutex m_mutex;
+
+    uint32_t m_setsPerPool;
+
+    // Maximum number of descriptors of each type in a single set of all allocated layouts
+    map<vk::DescriptorType, uint32_t> m_descriptorCounts;
+
+    vector<Pool> m_pools;
+    size_t m_currentPool = 0;
+};
+
+/* Inline implementation */
+
+uint32_t DescriptorAllocator::numPools() const
+{
+    return m_pools.size();
+}
+
+}
@@ -20,65 +20,90 @@ shared_ptr<DescriptorSet> DescriptorSet::create(
     descriptor->init();
     return descriptor;
 }
+vector<shared_ptr<DescriptorSet>> DescriptorSet::create(
+    const shared_ptr<DescriptorPool> &descriptorPool,
+    uint32_t count)
+{
+    auto descriptorSetLayout = descriptorPool->descriptorSetLayout();
+    auto device = descriptorSetLayout->device();
+
+    const vector<vk::DescriptorSetLayout> descriptorSetLayouts(count, *static_cast<const vk::DescriptorSetLayout *>(*descriptorSetLayout));
+
+    vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo;
+    descriptorSetAllocateInfo.descriptorPool = *descriptorPool;
+    descriptorSetAllocateInfo.descriptorSetCount = descriptorSetLayouts.size();
+    descriptorSetAllocateInfo.pSetLayouts = descriptorSetLayouts.data();
+    auto uniqueDescriptorSets = device->allocateDescriptorSetsUnique(descriptorSetAllocateInfo, device->dld());
+
+    vector<shared_ptr<DescriptorSet>> descriptorSets;
+    descriptorSets.reserve(uniqueDescriptorSets.size());
+    for (auto &&uniqueDescriptorSet : uniqueDescriptorSets)
+    {
+        descriptorSets.push_back(make_shared<DescriptorSet>(
+            descriptorPool,
+            move(uniqueDescriptorSet)
+        ));
+    }
+    return descriptorSets;
+}
 
 DescriptorSet::DescriptorSet(
     const shared_ptr<DescriptorPool> &descriptorPool)
     : m_descriptorPool(descriptorPool)
+    , m_descriptorSetLayout(descriptorPool->descriptorSetLayout())
 {}
-DescriptorSet::~DescriptorSet()
+DescriptorSet::DescriptorSet(
+    const shared_ptr<DescriptorPool> &descriptorPool,
+    vk::UniqueDescriptorSet &&descriptorSet)
+    : m_descriptorPool(descriptorPool)
+    , m_descriptorSetLayout(descriptorPool->descriptorSetLayout())
+    , m_descriptorSet(move(descriptorSet))
+{}
+DescriptorSet::DescriptorSet(
+    const shared_ptr<DescriptorAllocator> &descriptorAllocator,
+    const shared_ptr<DescriptorSetLayout> &descriptorSetLayout,
+    const DescriptorAllocator::Allocation &allocation)
+    : m_descriptorAllocator(descriptorAllocator)
+    , m_descriptorSetLayout(descriptorSetLayout)
+    , m_allocation(allocation)
 {}
+DescriptorSet::~DescriptorSet()
+{
+    if (m_descriptorAllocator)
+        m_descriptorAllocator->free(m_allocation);
+}
 
 void DescriptorSet::init()
 {
-    auto descriptorSetLayout = m_descriptorPool->descriptorSetLayout();
-
-    if (descriptorSetLayout->isEmpty())
+    if (m_descriptorSetLayout->isEmpty())
         return;
 
-    auto device = descriptorSetLayout->device();
+    auto device = m_descriptorSetLayout->device();
 
     vk::DescriptorSetAllocateInfo descriptorSetAllocateInfo;
     descriptorSetAllocateInfo.descriptorPool = *m_descriptorPool;
     descriptorSetAllocateInfo.descriptorSetCount = 1;
-    descriptorSetAllocateInfo.pSetLayouts = *descriptorSetLayout;
+    descriptorSetAllocateInfo.pSetLayouts = *m_descriptorSetLayout;
     m_descriptorSet = move(device->allocateDescriptorSetsUnique(descriptorSetAllocateInfo, device->dld())[0]);
 }
 
 void DescriptorSet::updateDescriptorInfos(const vector<DescriptorInfo> &descriptorInfos)
 {
-    auto descriptorSetLayout = m_descriptorPool->descriptorSetLayout();
-    auto device = descriptorSetLayout->device();
+    auto device = m_descriptorSetLayout->device();
 
-    const auto &descriptorTypes = descriptorSetLayout->descriptorTypes();
-
-    vector<vk::WriteDescriptorSet> writeDescriptorSets;
-    writeDescriptorSets.resize(descriptorInfos.size());
-    for (uint32_t t = 0, i = 0; t < descriptorTypes.size(); ++t)
+    if (auto descriptorUpdateTemplate = m_descriptorSetLayout->descriptorUpdateTemplate())
     {
-        const uint32_t arrSize = descriptorTypes[t].descriptorCount;
-        for (uint32_t e = 0; e < arrSize; ++e, ++i)
-        {
-            vk::WriteDescriptorSet &writeDescriptorSet = writeDescriptorSets[i];
-            writeDescriptorSet.dstSet = *m_descriptorSet;
-            writeDescriptorSet.dstBinding = t;
-            writeDescriptorSet.dstArrayElement = e;
-            writeDescriptorSet.descriptorCount = 1;
-            writeDescriptorSet.descriptorType = descriptorTypes[t].type;
-            switch (descriptorInfos[i].type)
-            {
-                case DescriptorInfo::Type::DescriptorImageInfo:
-                    writeDescriptorSet.pImageInfo = &descriptorInfos[i].descrImgInfo;
-                    break;
-                case DescriptorInfo::Type::DescriptorBufferInfo:
-                    writeDescriptorSet.pBufferInfo = &descriptorInfos[i].descrBuffInfo;
-                    break;
-                case DescriptorInfo::Type::BufferView:
-                    writeDescriptorSet.pTexelBufferView = &descriptorInfos[i].bufferView;
-                    break;
-            }
-        }
+        // The template reads the descriptor infos directly from the array
+        device->updateDescriptorSetWithTemplate(
+            *this,
+            descriptorUpdateTemplate,
+            descriptorInfos.data(),
+            device->dld()
+        );
+        return;
     }
 
+    const auto writeDescriptorSets = m_descriptorSetLayout->getWriteDescriptorSets(descriptorInfos, *this);
     device->updateDescriptorSets(writeDescriptorSets, nullptr, device->dld());
 }
 
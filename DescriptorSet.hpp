@@ -9,6 +9,7 @@
 #include "QmVkExport.hpp"
 
 #include "DescriptorSetLayout.hpp"
+#include "DescriptorAllocator.hpp"
 
 namespace QmVk {
 
@@ -25,18 +26,37 @@ public:
     static shared_ptr<DescriptorSet> create(
         const shared_ptr<DescriptorPool> &descriptorPool
     );
+    // Allocates all descriptor sets at once
+    static vector<shared_ptr<DescriptorSet>> create(
+        const shared_ptr<DescriptorPool> &descriptorPool,
+        uint32_t count
+    );
 
 public:
     DescriptorSet(
         const shared_ptr<DescriptorPool> &descriptorPool
     );
+    DescriptorSet(
+        const shared_ptr<DescriptorPool> &descriptorPool,
+        vk::UniqueDescriptorSet &&descriptorSet
+    );
+    // Use "DescriptorAllocator::allocate()"
+    DescriptorSet(
+        const shared_ptr<DescriptorAllocator> &descriptorAllocator,
+        const shared_ptr<DescriptorSetLayout> &descriptorSetLayout,
+        const DescriptorAllocator::Allocation &allocation
+    );
     ~DescriptorSet();
 
 private:
     void init();
 
 public:
+    // Null if allocated by "DescriptorAllocator"
     inline shared_ptr<DescriptorPool> descriptorPool() const;
+    inline shared_ptr<DescriptorAllocator> descriptorAllocator() const;
+
+    inline shared_ptr<DescriptorSetLayout> descriptorSetLayout() const;
 
     void updateDescriptorInfos(const vector<DescriptorInfo> &descriptorInfos);
 
@@ -45,8 +65,11 @@ public:
 
 private:
     const shared_ptr<DescriptorPool> m_descriptorPool;
+    const shared_ptr<DescriptorAllocator> m_descriptorAllocator;
+    const shared_ptr<DescriptorSetLayout> m_descriptorSetLayout;
 
     vk::UniqueDescriptorSet m_descriptorSet;
+    DescriptorAllocator::Allocation m_allocation;
 };
 
 /* Inline implementation */
@@ -55,10 +78,19 @@ shared_ptr<DescriptorPool> DescriptorSet::descriptorPool() const
 {
     return m_descriptorPool;
 }
+shared_ptr<DescriptorAllocator> DescriptorSet::descriptorAllocator() const
+{
+    return m_descriptorAllocator;
+}
+
+shared_ptr<DescriptorSetLayout> DescriptorSet::descriptorSetLayout() const
+{
+    return m_descriptorSetLayout;
+}
 
 DescriptorSet::operator vk::DescriptorSet() const
 {
-    return *m_descriptorSet;
+    return m_descriptorAllocator ? m_allocation.descriptorSet : *m_descriptorSet;
 }
 
 }
@@ -5,17 +5,23 @@
 */
 
 #include "DescriptorSetLayout.hpp"
+#include "DescriptorInfo.hpp"
+#include "PhysicalDevice.hpp"
 #include "Device.hpp"
 
+#include <cstddef>
+
 namespace QmVk {
 
 shared_ptr<DescriptorSetLayout> DescriptorSetLayout::create(
     const shared_ptr<Device> &device,
-    const vector<DescriptorType> &descriptorTypes)
+    const vector<DescriptorType> &descriptorTypes,
+    Mode mode)
 {
     auto descriptorSetLayout = make_shared<DescriptorSetLayout>(
         device,
-        descriptorTypes
+        descriptorTypes,
+        mode
     );
     descriptorSetLayout->init();
     return descriptorSetLayout;
@@ -23,9 +29,11 @@ shared_ptr<DescriptorSetLayout> DescriptorSetLayout::create(
 
 DescriptorSetLayout::DescriptorSetLayout(
     const shared_ptr<Device> &device,
-    const vector<DescriptorType> &descriptorTypes)
+    const vector<DescriptorType> &descriptorTypes,
+    Mode mode)
     : m_device(device)
     , m_descriptorTypes(descriptorTypes)
+    , m_mode(mode)
 {
 }
 DescriptorSetLayout::~DescriptorSetLayout()
@@ -51,7 +59,219 @@ void DescriptorSetLayout::init()
     vk::DescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo;
     descriptorSetLayoutCreateInfo.bindingCount = descriptorSetLayoutBindings.size();
     descriptorSetLayoutCreateInfo.pBindings = descriptorSetLayoutBindings.data();
-    m_descriptorSetLayout = m_device->createDescriptorSetLayoutUnique(descriptorSetLayoutCreateInfo, nullptr, m_device->dld());
+    switch (m_mode)
+    {
+        case Mode::DescriptorSet:
+            break;
+        case Mode::PushDescriptors:
+            if (!m_device->hasPushDescriptors())
+                throw vk::LogicError("Push descriptors are not supported");
+            descriptorSetLayoutCreateInfo.flags = vk::DescriptorSetLayoutCreateFlagBits::ePushDescriptorKHR;
+            break;
+        case Mode::DescriptorBuffer:
+            if (!m_device->hasDescriptorBuffer())
+                throw vk::LogicError("Descriptor buffer is not supported");
+            descriptorSetLayoutCreateInfo.flags = vk::DescriptorSetLayoutCreateFlagBits::eDescriptorBufferEXT;
+            break;
+    }
+    m_descriptorSetLayout = m_device->createDescriptorSetLayoutUnique(descriptorSetLayoutCreateInfo, m_device->allocationCallbacks(), m_device->dld());
+
+    if (m_mode == Mode::DescriptorBuffer)
+    {
+        const auto alignment = m_device->physicalDevice()->descriptorBufferProperties().descriptorBufferOffsetAlignment;
+
+        m_descriptorBufferSize = m_device->getDescriptorSetLayoutSizeEXT(*m_descriptorSetLayout, m_device->dld());
+        m_descriptorBufferSize = (m_descriptorBufferSize + alignment - 1) / alignment * alignment;
+
+        m_descriptorBufferOffsets.reserve(m_descriptorTypes.size());
+        for (uint32_t i = 0; i < m_descriptorTypes.size(); ++i)
+            m_descriptorBufferOffsets.push_back(m_device->getDescriptorSetLayoutBindingOffsetEXT(*m_descriptorSetLayout, i, m_device->dld()));
+    }
+    else if (m_mode == Mode::DescriptorSet && !m_descriptorTypes.empty() && m_device->hasDescriptorUpdateTemplate())
+    {
+        m_descriptorUpdateTemplate = createDescriptorUpdateTemplate(
+            vk::DescriptorUpdateTemplateType::eDescriptorSet,
+            vk::PipelineBindPoint::eCompute,
+            nullptr
+        );
+    }
+}
+
+vk::UniqueDescriptorUpdateTemplate DescriptorSetLayout::createPushDescriptorUpdateTemplate(
+    vk::PipelineBindPoint pipelineBindPoint,
+    vk::PipelineLayout pipelineLayout) const
+{
+    if (m_mode != Mode::PushDescriptors || m_descriptorTypes.empty() || !m_device->hasDescriptorUpdateTemplate())
+        return {};
+
+    return createDescriptorUpdateTemplate(
+        vk::DescriptorUpdateTemplateType::ePushDescriptorsKHR,
+        pipelineBindPoint,
+        pipelineLayout
+    );
+}
+
+vector<vk::WriteDescriptorSet> DescriptorSetLayout::getWriteDescriptorSets(
+    const vector<DescriptorInfo> &descriptorInfos,
+    vk::DescriptorSet dstSet) const
+{
+    vector<vk::WriteDescriptorSet> writeDescriptorSets;
+    writeDescriptorSets.resize(descriptorInfos.size());
+    for (uint32_t t = 0, i = 0; t < m_descriptorTypes.size(); ++t)
+    {
+        const uint32_t arrSize = m_descriptorTypes[t].descriptorCount;
+        for (uint32_t e = 0; e < arrSize; ++e, ++i)
+        {
+            vk::WriteDescriptorSet &writeDescriptorSet = writeDescriptorSets[i];
+            writeDescriptorSet.dstSet = dstSet;
+            writeDescriptorSet.dstBinding = t;
+            writeDescriptorSet.dstArrayElement = e;
+            writeDescriptorSet.descriptorCount = 1;
+            writeDescriptorSet.descriptorType = m_descriptorTypes[t].type;
+            switch (descriptorInfos[i].type)
+            {
+                case DescriptorInfo::Type::DescriptorImageInfo:
+                    writeDescriptorSet.pImageInfo = &descriptorInfos[i].descrImgInfo;
+                    break;
+                case DescriptorInfo::Type::DescriptorBufferInfo:
+                    writeDescriptorSet.pBufferInfo = &descriptorInfos[i].descrBuffInfo;
+                    break;
+                case DescriptorInfo::Type::BufferView:
+                    writeDescriptorSet.pTexelBufferView = &descriptorInfos[i].bufferView;
+                    break;
+            }
+        }
+    }
+    return writeDescriptorSets;
+}
+
+void DescriptorSetLayout::writeDescriptorBuffer(
+    void *data,
+    const vector<DescriptorInfo> &descriptorInfos) const
+{
+    if (m_mode != Mode::DescriptorBuffer)
+        throw vk::LogicError("Descriptor set layout doesn't use descriptor buffer");
+
+    const auto &props = m_device->physicalDevice()->descriptorBufferProperties();
+
+    for (uint32_t t = 0, i = 0; t < m_descriptorTypes.size(); ++t)
+    {
+        const auto descriptorType = m_descriptorTypes[t].type;
+        const uint32_t arrSize = m_descriptorTypes[t].descriptorCount;
+
+        vk::DescriptorGetInfoEXT descriptorGetInfo;
+        descriptorGetInfo.type = descriptorType;
+
+        size_t descriptorSize = 0;
+        switch (descriptorType)
+        {
+            case vk::DescriptorType::eUniformBuffer:
+                descriptorSize = props.uniformBufferDescriptorSize;
+                break;
+            case vk::DescriptorType::eStorageBuffer:
+                descriptorSize = props.storageBufferDescriptorSize;
+                break;
+            case vk::DescriptorType::eCombinedImageSampler:
+                descriptorSize = props.combinedImageSamplerDescriptorSize;
+                break;
+            case vk::DescriptorType::eSampledImage:
+                descriptorSize = props.sampledImageDescriptorSize;
+                break;
+            case vk::DescriptorType::eStorageImage:
+                descriptorSize = props.storageImageDescriptorSize;
+                break;
+            default:
+                throw vk::LogicError("Unsupported descriptor type for descriptor buffer: " + vk::to_string(descriptorType));
+        }
+
+        for (uint32_t e = 0; e < arrSize; ++e, ++i)
+        {
+            const auto &descriptorInfo = descriptorInfos[i];
+
+            vk::DescriptorAddressInfoEXT descriptorAddressInfo;
+            switch (descriptorType)
+            {
+                case vk::DescriptorType::eUniformBuffer:
+                case vk::DescriptorType::eStorageBuffer:
+                    descriptorAddressInfo.address = m_device->getBufferAddress(vk::BufferDeviceAddressInfo(descriptorInfo.descrBuffInfo.buffer), m_device->dld()) + descriptorInfo.descrBuffInfo.offset;
+                    descriptorAddressInfo.range = descriptorInfo.descrBuffInfo.range;
+                    if (descriptorType == vk::DescriptorType::eUniformBuffer)
+                        descriptorGetInfo.data.pUniformBuffer = &descriptorAddressInfo;
+                    else
+                        descriptorGetInfo.data.pStorageBuffer = &descriptorAddressInfo;
+                    break;
+                case vk::DescriptorType::eCombinedImageSampler:
+                    descriptorGetInfo.data.pCombinedImageSampler = &descriptorInfo.descrImgInfo;
+                    break;
+                case vk::DescriptorType::eSampledImage:
+                    descriptorGetInfo.data.pSampledImage = &descriptorInfo.descrImgInfo;
+                    break;
+                case vk::DescriptorType::eStorageImage:
+                    descriptorGetInfo.data.pStorageImage = &descriptorInfo.descrImgInfo;
+                    break;
+                default:
+                    break;
+            }
+
+            m_device->getDescriptorEXT(
+                descriptorGetInfo,
+                descriptorSize,
+                static_cast<uint8_t *>(data) + m_descriptorBufferOffsets[t] + e * descriptorSize,
+                m_device->dld()
+            );
+        }
+    }
+}
+
+vk::UniqueDescriptorUpdateTemplate DescriptorSetLayout::createDescriptorUpdateTemplate(
+    vk::DescriptorUpdateTemplateType templateType,
+    vk::PipelineBindPoint pipelineBindPoint,
+    vk::PipelineLayout pipelineLayout) const
+{
+    vector<vk::DescriptorUpdateTemplateEntry> descriptorUpdateTemplateEntries;
+    descriptorUpdateTemplateEntries.reserve(m_descriptorTypes.size());
+
+    size_t descriptorInfoIdx = 0;
+    for (uint32_t i = 0; i < m_descriptorTypes.size(); ++i)
+    {
+        size_t offset = descriptorInfoIdx * sizeof(DescriptorInfo);
+        switch (m_descriptorTypes[i].type)
+        {
+            case vk::DescriptorType::eUniformBuffer:
+            case vk::DescriptorType::eStorageBuffer:
+            case vk::DescriptorType::eUniformBufferDynamic:
+            case vk::DescriptorType::eStorageBufferDynamic:
+                offset += offsetof(DescriptorInfo, descrBuffInfo);
+                break;
+            case vk::DescriptorType::eUniformTexelBuffer:
+            case vk::DescriptorType::eStorageTexelBuffer:
+                offset += offsetof(DescriptorInfo, bufferView);
+                break;
+            default:
+                offset += offsetof(DescriptorInfo, descrImgInfo);
+                break;
+        }
+
+        vk::DescriptorUpdateTemplateEntry descriptorUpdateTemplateEntry;
+        descriptorUpdateTemplateEntry.dstBinding = i;
+        descriptorUpdateTemplateEntry.descriptorCount = m_descriptorTypes[i].descriptorCount;
+        descriptorUpdateTemplateEntry.descriptorType = m_descriptorTypes[i].type;
+        descriptorUpdateTemplateEntry.offset = offset;
+        descriptorUpdateTemplateEntry.stride = sizeof(DescriptorInfo);
+        descriptorUpdateTemplateEntries.push_back(descriptorUpdateTemplateEntry);
+
+        descriptorInfoIdx += m_descriptorTypes[i].descriptorCount;
+    }
+
+    vk::DescriptorUpdateTemplateCreateInfo descriptorUpdateTemplateCreateInfo;
+    descriptorUpdateTemplateCreateInfo.descriptorUpdateEntryCount = descriptorUpdateTemplateEntries.size();
+    descriptorUpdateTemplateCreateInfo.pDescriptorUpdateEntries = descriptorUpdateTemplateEntries.data();
+    descriptorUpdateTemplateCreateInfo.templateType = templateType;
+    descriptorUpdateTemplateCreateInfo.descriptorSetLayout = *m_descriptorSetLayout;
+    descriptorUpdateTemplateCreateInfo.pipelineBindPoint = pipelineBindPoint;
+    descriptorUpdateTemplateCreateInfo.pipelineLayout = pipelineLayout;
+    descriptorUpdateTemplateCreateInfo.set = 0;
+    return m_device->createDescriptorUpdateTemplateUnique(descriptorUpdateTemplateCreateInfo, m_device->allocationCallbacks(), m_device->dld());
 }
 
 }
@@ -17,39 +17,88 @@ namespace QmVk {
 using namespace std;
 
 class Device;
+class DescriptorInfo;
 
 class QMVK_EXPORT DescriptorSetLayout
 {
+public:
+    enum class Mode
+    {
+        DescriptorSet,
+        PushDescriptors, // no descriptor set can be allocated
+        DescriptorBuffer, // no descriptor set can be allocated, requires "Device::hasDescriptorBuffer()"
+    };
+
 public:
     static shared_ptr<DescriptorSetLayout> create(
         const shared_ptr<Device> &device,
-        const vector<DescriptorType> &descriptorTypes
+        const vector<DescriptorType> &descriptorTypes,
+        Mode mode = Mode::DescriptorSet
     );
 
 public:
     DescriptorSetLayout(
         const shared_ptr<Device> &device,
-        const vector<DescriptorType> &descriptorTypes
+        const vector<DescriptorType> &descriptorTypes,
+        Mode mode
     );
     ~DescriptorSetLayout();
 
 private:
     void init();
 
+    vk::UniqueDescriptorUpdateTemplate createDescriptorUpdateTemplate(
+        vk::DescriptorUpdateTemplateType templateType,
+        vk::PipelineBindPoint pipelineBindPoint,
+        vk::PipelineLayout pipelineLayout
+    ) const;
+
 public:
     inline shared_ptr<Device> device() const;
 
     inline bool isEmpty() const;
     inline const vector<DescriptorType> &descriptorTypes() const;
 
+    inline Mode mode() const;
+    inline bool isPushDescriptors() const;
+    inline bool isDescriptorBuffer() const;
+
+    // Updates a descriptor set directly from an array of "DescriptorInfo", empty if not supported
+    inline vk::DescriptorUpdateTemplate descriptorUpdateTemplate() const;
+
+    // Pushes descriptors directly from an array of "DescriptorInfo", empty if not supported
+    vk::UniqueDescriptorUpdateTemplate createPushDescriptorUpdateTemplate(
+        vk::PipelineBindPoint pipelineBindPoint,
+        vk::PipelineLayout pipelineLayout
+    ) const;
+
+    // One write per descriptor, used when no descriptor update template is available
+    vector<vk::WriteDescriptorSet> getWriteDescriptorSets(
+        const vector<DescriptorInfo> &descriptorInfos,
+        vk::DescriptorSet dstSet = nullptr
+    ) const;
+
+    // Size of descriptor buffer memory needed by the layout, aligned to "descriptorBufferOffsetAlignment"
+    inline vk::DeviceSize descriptorBufferSize() const;
+    // Writes descriptors into descriptor buffer memory
+    void writeDescriptorBuffer(
+        void *data,
+        const vector<DescriptorInfo> &descriptorInfos
+    ) const;
+
 public:
     inline operator const vk::DescriptorSetLayout *() const;
 
 private:
     const shared_ptr<Device> m_device;
     const vector<DescriptorType> m_descriptorTypes;
+    const Mode m_mode;
 
     vk::UniqueDescriptorSetLayout m_descriptorSetLayout;
+    vk::UniqueDescriptorUpdateTemplate m_descriptorUpdateTemplate;
+
+    vk::DeviceSize m_descriptorBufferSize = 0;
+    vector<vk::DeviceSize> m_descriptorBufferOffsets; // for each binding
 };
 
 /* Inline implementation */
@@ -68,6 +117,29 @@ const vector<DescriptorType> &DescriptorSetLayout::descriptorTypes() const
     return m_descriptorTypes;
 }
 
+DescriptorSetLayout::Mode DescriptorSetLayout::mode() const
+{
+    return m_mode;
+}
+bool DescriptorSetLayout::isPushDescriptors() const
+{
+    return (m_mode == Mode::PushDescriptors);
+}
+bool DescriptorSetLayout::isDescriptorBuffer() const
+{
+    return (m_mode == Mode::DescriptorBuffer);
+}
+
+vk::DeviceSize DescriptorSetLayout::descriptorBufferSize() const
+{
+    return m_descriptorBufferSize;
+}
+
+vk::DescriptorUpdateTemplate DescriptorSetLayout::descriptorUpdateTemplate() const
+{
+    return *m_descriptorUpdateTemplate;
+}
+
 DescriptorSetLayout::operator const vk::DescriptorSetLayout *() const
 {
     return &*m_descriptorSetLayout;
@@ -7,7 +7,16 @@
 #include "Device.hpp"
 #include "AbstractInstance.hpp"
 #include "PhysicalDevice.hpp"
+#include "MemoryAllocator.hpp"
+#include "CommandBufferPool.hpp"
+#include "PipelineCache.hpp"
+#include "WorkerPool.hpp"
+#include "PipelineManifest.hpp"
+#include "LayoutCache.hpp"
+#include "DescriptorAllocator.hpp"
+#include "TransferBatch.hpp"
 #include "Queue.hpp"
+#include "HostAllocator.hpp"
 
 #include <cstring>
 
@@ -19,14 +28,30 @@ Device::Device(const shared_ptr<PhysicalDevice> &physicalDevice)
 {}
 Device::~Device()
 {
+    // All queues are destroyed at this point, so all pending work is finished
+    for (auto &&pendingRelease : m_pendingReleases)
+        pendingRelease.release();
+    m_pendingReleases.clear();
+
+    m_layoutCache.reset();
+    m_pipelineManifest.reset();
+    m_workerPool.reset();
+    m_pipelineCache.reset();
+    m_commandBufferPool.reset();
+    m_memoryAllocator.reset();
     if (*this)
-        destroy(nullptr, dld());
+        destroy(allocationCallbacks(), dld());
 }
 
 void Device::init(const vk::PhysicalDeviceFeatures2 &features,
     const vector<const char *> &extensions,
-    const vector<pair<uint32_t, uint32_t>> &queuesFamilyIn)
+    const vector<pair<uint32_t, uint32_t>> &queuesFamilyIn,
+    const shared_ptr<HostAllocator> &hostAllocator)
 {
+    m_hostAllocator = hostAllocator;
+    if (m_hostAllocator)
+        m_allocationCallbacks = m_hostAllocator->callbacks();
+
     vector<pair<uint32_t, uint32_t>> queuesFamily;
     queuesFamily.reserve(queuesFamilyIn.size());
 
@@ -71,6 +96,7 @@ void Device::init(const vk::PhysicalDeviceFeatures2 &features,
     m_enabledExtensions.reserve(extensions.size());
     for (auto &&extension : extensions)
         m_enabledExtensions.insert(extension);
+    m_enabledFeatures = features.features;
 
     const auto instance = m_physicalDevice->instance();
     const bool hasPhysDevs2Props = !instance->isVk10() || instance->checkExtension(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
@@ -84,16 +110,54 @@ void Device::init(const vk::PhysicalDeviceFeatures2 &features,
         deviceCreateInfo.pNext = &features;
     else
         deviceCreateInfo.pEnabledFeatures = &features.features;
-    static_cast<vk::Device &>(*this) = m_physicalDevice->createDevice(deviceCreateInfo, nullptr, dld());
+    static_cast<vk::Device &>(*this) = m_physicalDevice->createDevice(deviceCreateInfo, allocationCallbacks(), dld());
+
+    // Device functions from "vkGetDeviceProcAddr()" don't go through the loader trampolines. Functions of
+    // extensions which are not enabled are null, core functions fall back to their extension aliases, but not
+    // the other way round, so promoted functions must be called by their core names.
+    m_dld.init(static_cast<vk::Device>(*this));
+
+    {
+        const auto version = m_physicalDevice->version();
+        const bool hasV11 = (version.first > 1 || version.second >= 1);
+        const bool hasV13 = (version.first > 1 || version.second >= 3);
+        m_hasPipelineCreationFeedback = (hasV13 || hasExtension(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME));
+        m_hasDescriptorUpdateTemplate = (hasV11 || hasExtension(VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME));
+        m_hasPushDescriptors = (hasExtension(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME) && m_physicalDevice->maxPushDescriptors() > 0);
+    }
 
     if (hasPhysDevs2Props)
     {
         const auto version = m_physicalDevice->version();
         const bool hasV11 = (version.first > 1 || version.second >= 1);
+        const bool hasV12 = (version.first > 1 || version.second >= 2);
         const bool hasV13 = (version.first > 1 || version.second >= 3);
 
         const bool ycbcr = (hasV11 || hasExtension(VK_KHR_SAMPLER_YCBCR_CONVERSION_EXTENSION_NAME));
         const bool sync2 = (hasV13 || hasExtension(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME));
+        const bool timelineSemaphore = (hasV12 || hasExtension(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME));
+        const bool extendedDynamicState = hasExtension(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+        const bool dynamicRendering = (hasV13 || hasExtension(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME));
+        const bool descriptorIndexing = (hasV12 || hasExtension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME));
+        const bool bufferDeviceAddress = (hasV12 || hasExtension(VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME));
+        const bool descriptorBuffer = hasExtension(VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME);
+        bool descriptorBufferFeature = false;
+        const bool shaderObject = hasExtension(VK_EXT_SHADER_OBJECT_EXTENSION_NAME);
+        bool shaderObjectFeature = false;
+
+        // Features needed by "BindlessTable"
+        auto hasBindlessFeatures = [](const auto &descriptorIndexingFeatures) {
+            return (descriptorIndexingFeatures.runtimeDescriptorArray
+                && descriptorIndexingFeatures.descriptorBindingPartiallyBound
+                && descriptorIndexingFeatures.descriptorBindingUpdateUnusedWhilePending
+                && descriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind
+                && descriptorIndexingFeatures.descriptorBindingStorageImageUpdateAfterBind
+                && descriptorIndexingFeatures.descriptorBindingStorageBufferUpdateAfterBind
+            );
+        };
+
+        // Extended dynamic state is always available in Vulkan 1.3
+        m_hasExtendedDynamicState = hasV13;
 
         auto pNext = reinterpret_cast<vk::BaseOutStructure *>(features.pNext);
         while (pNext)
@@ -108,12 +172,68 @@ void Device::init(const vk::PhysicalDeviceFeatures2 &features,
                     if (sync2 && reinterpret_cast<vk::PhysicalDeviceSynchronization2FeaturesKHR *>(pNext)->synchronization2)
                         m_hasSync2 = true;
                     break;
+                case vk::StructureType::ePhysicalDeviceTimelineSemaphoreFeatures:
+                    if (timelineSemaphore && reinterpret_cast<vk::PhysicalDeviceTimelineSemaphoreFeatures *>(pNext)->timelineSemaphore)
+                        m_hasTimelineSemaphore = true;
+                    break;
+                case vk::StructureType::ePhysicalDeviceExtendedDynamicStateFeaturesEXT:
+                    if (extendedDynamicState && reinterpret_cast<vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT *>(pNext)->extendedDynamicState)
+                        m_hasExtendedDynamicState = true;
+                    break;
+                case vk::StructureType::ePhysicalDeviceDynamicRenderingFeatures:
+                    if (dynamicRendering && reinterpret_cast<vk::PhysicalDeviceDynamicRenderingFeatures *>(pNext)->dynamicRendering)
+                        m_hasDynamicRendering = true;
+                    break;
+                case vk::StructureType::ePhysicalDeviceVulkan13Features:
+                    if (hasV13 && reinterpret_cast<vk::PhysicalDeviceVulkan13Features *>(pNext)->dynamicRendering)
+                        m_hasDynamicRendering = true;
+                    break;
+                case vk::StructureType::ePhysicalDeviceDescriptorIndexingFeatures:
+                    if (descriptorIndexing && hasBindlessFeatures(*reinterpret_cast<vk::PhysicalDeviceDescriptorIndexingFeatures *>(pNext)))
+                        m_hasDescriptorIndexing = true;
+                    break;
+                case vk::StructureType::ePhysicalDeviceBufferDeviceAddressFeatures:
+                    if (bufferDeviceAddress && reinterpret_cast<vk::PhysicalDeviceBufferDeviceAddressFeatures *>(pNext)->bufferDeviceAddress)
+                        m_hasBufferDeviceAddress = true;
+                    break;
+                case vk::StructureType::ePhysicalDeviceDescriptorBufferFeaturesEXT:
+                    if (descriptorBuffer && reinterpret_cast<vk::PhysicalDeviceDescriptorBufferFeaturesEXT *>(pNext)->descriptorBuffer)
+                        descriptorBufferFeature = true;
+                    break;
+                case vk::StructureType::ePhysicalDeviceShaderObjectFeaturesEXT:
+                    if (shaderObject && reinterpret_cast<vk::PhysicalDeviceShaderObjectFeaturesEXT *>(pNext)->shaderObject)
+                        shaderObjectFeature = true;
+                    break;
+                case vk::StructureType::ePhysicalDeviceVulkan12Features:
+                {
+                    const auto vulkan12Features = reinterpret_cast<vk::PhysicalDeviceVulkan12Features *>(pNext);
+                    if (hasV12 && vulkan12Features->timelineSemaphore)
+                        m_hasTimelineSemaphore = true;
+                    if (hasV12 && vulkan12Features->descriptorIndexing && hasBindlessFeatures(*vulkan12Features))
+                        m_hasDescriptorIndexing = true;
+                    if (hasV12 && vulkan12Features->bufferDeviceAddress)
+                        m_hasBufferDeviceAddress = true;
+                    break;
+                }
                 default:
                     break;
             }
             pNext = pNext->pNext;
         }
+
+        // Descriptor buffers are bound by their device address
+        m_hasDescriptorBuffer = (descriptorBufferFeature && m_hasBufferDeviceAddress);
+
+        // Shader objects require dynamic rendering
+        m_hasShaderObject = (shaderObjectFeature && m_hasDynamicRendering);
     }
+
+    m_memoryAllocator = make_unique<MemoryAllocator>(*this);
+    m_commandBufferPool = make_unique<CommandBufferPool>(*this);
+    m_pipelineCache = make_unique<PipelineCache>(*this);
+    m_workerPool = make_unique<WorkerPool>();
+    m_pipelineManifest = make_unique<PipelineManifest>(*this);
+    m_layoutCache = make_unique<LayoutCache>(*this);
 }
 
 shared_ptr<Queue> Device::queue(uint32_t queueFamilyIndex, uint32_t index)
@@ -133,4 +253,111 @@ shared_ptr<Queue> Device::queue(uint32_t queueFamilyIndex, uint32_t index)
     return queue;
 }
 
+void Device::deferRelease(ReleaseCallback &&release)
+{
+    vector<shared_ptr<Queue>> queues;
+
+    {
+        lock_guard<mutex> locker(m_queueMutex);
+        for (auto &&weakQueues : m_weakQueues)
+        {
+            for (auto &&weakQueue : weakQueues.second)
+            {
+                if (auto queue = weakQueue.lock())
+                    queues.push_back(move(queue));
+            }
+        }
+    }
+
+    PendingRelease pendingRelease;
+    for (auto &&queue : queues)
+    {
+        const auto submittedValue = queue->submittedValue();
+        if (!queue->hasFinished(submittedValue))
+            pendingRelease.submissions.emplace_back(queue, submittedValue);
+    }
+
+    bool deferred = false;
+
+    {
+        lock_guard<mutex> locker(m_releaseMutex);
+        if (!pendingRelease.submissions.empty() || !m_pendingReleases.empty())
+        {
+            pendingRelease.release = move(release);
+            m_pendingReleases.push_back(move(pendingRelease));
+            deferred = true;
+        }
+    }
+
+    if (!deferred)
+        release();
+
+    collectReleases();
+}
+void Device::collectReleases()
+{
+    vector<ReleaseCallback> releases;
+
+    {
+        unique_lock<mutex> locker(m_releaseMutex, try_to_lock);
+        if (!locker.owns_lock())
+            return;
+
+        // Release in order, so e.g. memory is never freed before the image bound to it
+        while (!m_pendingReleases.empty())
+        {
+            auto &submissions = m_pendingReleases.front().submissions;
+            for (auto it = submissions.begin(); it != submissions.end();)
+            {
+                auto queue = it->first.lock();
+                if (!queue || queue->hasFinished(it->second))
+                    it = submissions.erase(it);
+                else
+                    ++it;
+            }
+            if (!submissions.empty())
+                break;
+
+            releases.push_back(move(m_pendingReleases.front().release));
+            m_pendingReleases.pop_front();
+        }
+    }
+
+    for (auto &&release : releases)
+        release();
+}
+
+shared_ptr<DescriptorAllocator> Device::descriptorAllocator()
+{
+    lock_guard<mutex> locker(m_descriptorAllocatorMutex);
+    auto descriptorAllocator = m_descriptorAllocator.lock();
+    if (!descriptorAllocator)
+    {
+        descriptorAllocator = DescriptorAllocator::create(shared_from_this());
+        m_descriptorAllocator = descriptorAllocator;
+    }
+    return descriptorAllocator;
+}
+
+shared_ptr<TransferBatch> Device::transferBatch()
+{
+    lock_guard<mutex> locker(m_transferBatchMutex);
+    return m_transferBatch.lock();
+}
+
+void Device::setTransferBatch(const shared_ptr<TransferBatch> &transferBatch)
+{
+    lock_guard<mutex> locker(m_transferBatchMutex);
+    auto currentTransferBatch = m_transferBatch.lock();
+    if (currentTransferBatch && currentTransferBatch != transferBatch)
+        throw vk::LogicError("Another transfer batch is already active");
+    m_transferBatch = transferBatch;
+}
+void Device::resetTransferBatch(const TransferBatch *transferBatch)
+{
+    lock_guard<mutex> locker(m_transferBatchMutex);
+    if (m_transferBatch.lock().get() == transferBatch)
+        m_transferBatch.reset();
+}
+
 }
@@ -12,8 +12,11 @@
 
 #include <unordered_map>
 #include <unordered_set>
+#include <functional>
 #include <memory>
+#include <atomic>
 #include <mutex>
+#include <deque>
 
 namespace QmVk {
 
@@ -21,11 +24,32 @@ using namespace std;
 
 class PhysicalDevice;
 class MemoryPropertyFlags;
+class MemoryAllocator;
+class CommandBufferPool;
+class PipelineCache;
+class WorkerPool;
+class PipelineManifest;
+class LayoutCache;
+class DescriptorAllocator;
+class TransferBatch;
 class Queue;
+class HostAllocator;
 
 class QMVK_EXPORT Device : public vk::Device, public enable_shared_from_this<Device>
 {
     friend class PhysicalDevice;
+    friend class TransferBatch;
+    friend class BarrierBatch;
+
+public:
+    using ReleaseCallback = function<void()>;
+
+private:
+    struct PendingRelease
+    {
+        vector<pair<weak_ptr<Queue>, uint64_t>> submissions; // {queue, last submitted value}
+        ReleaseCallback release;
+    };
 
 public:
     Device(const shared_ptr<PhysicalDevice> &physicalDevice);
@@ -35,18 +59,38 @@ private:
     void init(
         const vk::PhysicalDeviceFeatures2 &features,
         const vector<const char *> &extensions,
-        const vector<pair<uint32_t, uint32_t>> &queuesFamilyIn // {family index, max count}
+        const vector<pair<uint32_t, uint32_t>> &queuesFamilyIn, // {family index, max count}
+        const shared_ptr<HostAllocator> &hostAllocator
     );
 
 public:
     inline shared_ptr<PhysicalDevice> physicalDevice() const;
     inline const vk::detail::DispatchLoaderDynamic &dld() const;
 
+    // Used by all device calls, "nullptr" if no host allocator is set
+    inline shared_ptr<HostAllocator> hostAllocator() const;
+    inline const vk::AllocationCallbacks *allocationCallbacks() const;
+
     inline const auto &enabledExtensions() const;
     inline bool hasExtension(const char *extensionName) const;
 
+    inline const vk::PhysicalDeviceFeatures &enabledFeatures() const;
+
     inline bool hasYcbcr() const;
     inline bool hasSync2() const;
+    inline bool hasTimelineSemaphore() const;
+    inline bool hasPipelineCreationFeedback() const;
+    inline bool hasExtendedDynamicState() const;
+    inline bool hasDynamicRendering() const;
+    inline bool hasDescriptorUpdateTemplate() const;
+    inline bool hasPushDescriptors() const;
+    inline bool hasDescriptorIndexing() const;
+    inline bool hasBufferDeviceAddress() const;
+    // Enabled by "VK_EXT_descriptor_buffer" and its feature at device creation, pipelines write descriptors
+    // directly into buffers instead of using descriptor sets
+    inline bool hasDescriptorBuffer() const;
+    // "VK_EXT_shader_object", pipelines can use shader objects instead of pipeline objects
+    inline bool hasShaderObject() const;
 
     inline const auto &queues() const;
 
@@ -57,18 +101,74 @@ public:
     shared_ptr<Queue> queue(uint32_t queueFamilyIndex, uint32_t index);
     inline shared_ptr<Queue> firstQueue();
 
+    inline MemoryAllocator *memoryAllocator() const;
+    inline CommandBufferPool *commandBufferPool() const;
+    inline PipelineCache *pipelineCache() const;
+    inline WorkerPool *workerPool() const;
+    inline PipelineManifest *pipelineManifest() const;
+    inline LayoutCache *layoutCache() const;
+
+    // Shared by pipelines, created when needed and destroyed with its last descriptor set
+    shared_ptr<DescriptorAllocator> descriptorAllocator();
+
+    // Number of "vkCmdPipelineBarrier" calls avoided by batching barriers
+    inline uint64_t savedBarrierCalls() const;
+
+    // Returns the currently active transfer batch, if any
+    shared_ptr<TransferBatch> transferBatch();
+
+    // Calls the release function once all work currently submitted to any queue is finished
+    void deferRelease(ReleaseCallback &&release);
+    void collectReleases();
+
+private:
+    void setTransferBatch(const shared_ptr<TransferBatch> &transferBatch);
+    void resetTransferBatch(const TransferBatch *transferBatch);
+
 private:
     const shared_ptr<PhysicalDevice> m_physicalDevice;
-    const vk::detail::DispatchLoaderDynamic &m_dld;
+    vk::detail::DispatchLoaderDynamic m_dld; // device functions are loaded directly from the driver
+
+    shared_ptr<HostAllocator> m_hostAllocator;
+    const vk::AllocationCallbacks *m_allocationCallbacks = nullptr;
 
     unordered_set<string> m_enabledExtensions;
+    vk::PhysicalDeviceFeatures m_enabledFeatures;
     bool m_hasYcbcr = false;
     bool m_hasSync2 = false;
+    bool m_hasTimelineSemaphore = false;
+    bool m_hasPipelineCreationFeedback = false;
+    bool m_hasExtendedDynamicState = false;
+    bool m_hasDynamicRendering = false;
+    bool m_hasDescriptorUpdateTemplate = false;
+    bool m_hasPushDescriptors = false;
+    bool m_hasDescriptorIndexing = false;
+    bool m_hasBufferDeviceAddress = false;
+    bool m_hasDescriptorBuffer = false;
+    bool m_hasShaderObject = false;
 
     vector<uint32_t> m_queues;
 
     mutex m_queueMutex;
     unordered_map<uint32_t, vector<weak_ptr<Queue>>> m_weakQueues;
+
+    unique_ptr<MemoryAllocator> m_memoryAllocator;
+    unique_ptr<CommandBufferPool> m_commandBufferPool;
+    unique_ptr<PipelineCache> m_pipelineCache;
+    unique_ptr<WorkerPool> m_workerPool;
+    unique_ptr<PipelineManifest> m_pipelineManifest;
+    unique_ptr<LayoutCache> m_layoutCache;
+
+    mutex m_descriptorAllocatorMutex;
+    weak_ptr<DescriptorAllocator> m_descriptorAllocator;
+
+    mutex m_transferBatchMutex;
+    weak_ptr<TransferBatch> m_transferBatch;
+
+    mutex m_releaseMutex;
+    deque<PendingRelease> m_pendingReleases;
+
+    atomic<uint64_t> m_savedBarrierCalls {0};
 };
 
 /* Inline implementation */
@@ -82,6 +182,15 @@ const vk::detail::DispatchLoaderDynamic &Device::dld() const
     return m_dld;
 }
 
+shared_ptr<HostAllocator> Device::hostAllocator() const
+{
+    return m_hostAllocator;
+}
+const vk::AllocationCallbacks *Device::allocationCallbacks() const
+{
+    return m_allocationCallbacks;
+}
+
 const auto &Device::enabledExtensions() const
 {
     return m_enabledExtensions;
@@ -91,6 +200,11 @@ bool Device::hasExtension(const char *extensionName) const
     return (m_enabledExtensions.count(extensionName) > 0);
 }
 
+const vk::PhysicalDeviceFeatures &Device::enabledFeatures() const
+{
+    return m_enabledFeatures;
+}
+
 bool Device::hasYcbcr() const
 {
     return m_hasYcbcr;
@@ -99,6 +213,46 @@ bool Device::hasSync2() const
 {
     return m_hasSync2;
 }
+bool Device::hasTimelineSemaphore() const
+{
+    return m_hasTimelineSemaphore;
+}
+bool Device::hasPipelineCreationFeedback() const
+{
+    return m_hasPipelineCreationFeedback;
+}
+bool Device::hasExtendedDynamicState() const
+{
+    return m_hasExtendedDynamicState;
+}
+bool Device::hasDynamicRendering() const
+{
+    return m_hasDynamicRendering;
+}
+bool Device::hasDescriptorUpdateTemplate() const
+{
+    return m_hasDescriptorUpdateTemplate;
+}
+bool Device::hasPushDescriptors() const
+{
+    return m_hasPushDescriptors;
+}
+bool Device::hasDescriptorIndexing() const
+{
+    return m_hasDescriptorIndexing;
+}
+bool Device::hasBufferDeviceAddress() const
+{
+    return m_hasBufferDeviceAddress;
+}
+bool Device::hasDescriptorBuffer() const
+{
+    return m_hasDescriptorBuffer;
+}
+bool Device::hasShaderObject() const
+{
+    return m_hasShaderObject;
+}
 
 const auto &Device::queues() const
 {
@@ -123,4 +277,34 @@ shared_ptr<Queue> Device::firstQueue()
     return queue(queueFamilyIndex(0), 0);
 }
 
+MemoryAllocator *Device::memoryAllocator() const
+{
+    return m_memoryAllocator.get();
+}
+CommandBufferPool *Device::commandBufferPool() const
+{
+    return m_commandBufferPool.get();
+}
+PipelineCache *Device::pipelineCache() const
+{
+    return m_pipelineCache.get();
+}
+WorkerPool *Device::workerPool() const
+{
+    return m_workerPool.get();
+}
+PipelineManifest *Device::pipelineManifest() const
+{
+    return m_pipelineManifest.get();
+}
+LayoutCache *Device::layoutCache() const
+{
+    return m_layoutCache.get();
+}
+
+uint64_t Device::savedBarrierCalls() const
+{
+    return m_savedBarrierCalls;
+}
+
 }
@@ -6,6 +6,7 @@
 
 #include "GraphicsPipeline.hpp"
 #include "Device.hpp"
+#include "PipelineCache.hpp"
 #include "ShaderModule.hpp"
 #include "RenderPass.hpp"
 #include "CommandBuffer.hpp"
@@ -23,10 +24,20 @@ GraphicsPipeline::GraphicsPipeline(CreateInfo &createInfo)
     , m_vertexShaderModule(move(createInfo.vertexShaderModule))
     , m_fragmentShaderModule(move(createInfo.fragmentShaderModule))
     , m_renderPass(move(createInfo.renderPass))
-    , m_size(createInfo.size)
+    , m_colorFormat(m_renderPass ? m_renderPass->format() : createInfo.colorFormat)
+    , m_dynamicSize(createInfo.dynamicSize)
+    , m_extendedDynamicState(m_dynamicSize && m_device->hasExtendedDynamicState())
     , m_vertexBindingDescrs(move(createInfo.vertexBindingDescrs))
     , m_vertexAttrDescrs(move(createInfo.vertexAttrDescrs))
 {
+    if (!m_renderPass)
+    {
+        if (!m_device->hasDynamicRendering())
+            throw vk::LogicError("GraphicsPipeline without render pass requires dynamic rendering");
+        if (m_colorFormat == vk::Format::eUndefined)
+            throw vk::LogicError("GraphicsPipeline without render pass requires color format");
+    }
+
     if (createInfo.colorBlendAttachment)
     {
         m_colorBlendAttachment = *createInfo.colorBlendAttachment;
@@ -66,24 +77,90 @@ GraphicsPipeline::GraphicsPipeline(CreateInfo &createInfo)
         m_rasterizer.cullMode = vk::CullModeFlagBits::eFront;
         m_rasterizer.lineWidth = 1.0f;
     }
+
+    if (canUseShaderObjects())
+    {
+        m_vertexBindingDescrs2.reserve(m_vertexBindingDescrs.size());
+        for (auto &&vertexBindingDescr : m_vertexBindingDescrs)
+        {
+            m_vertexBindingDescrs2.emplace_back(
+                vertexBindingDescr.binding,
+                vertexBindingDescr.stride,
+                vertexBindingDescr.inputRate,
+                1
+            );
+        }
+        m_vertexAttrDescrs2.reserve(m_vertexAttrDescrs.size());
+        for (auto &&vertexAttrDescr : m_vertexAttrDescrs)
+        {
+            m_vertexAttrDescrs2.emplace_back(
+                vertexAttrDescr.location,
+                vertexAttrDescr.binding,
+                vertexAttrDescr.format,
+                vertexAttrDescr.offset
+            );
+        }
+    }
+
+    m_size = createInfo.size;
+    m_cullMode = m_rasterizer.cullMode;
+    m_topology = m_inputAssembly.topology;
 }
 GraphicsPipeline::~GraphicsPipeline()
 {}
 
-void GraphicsPipeline::createPipeline()
+void GraphicsPipeline::createPipeline(const Variant &variant, vk::PipelineLayout pipelineLayout, Program &program) const
 {
-    vk::Viewport viewport;
-    viewport.width = m_size.width;
-    viewport.height = m_size.height;
+    // Static state is stored in the variant data, see "appendVariantData()"
+    uint32_t variantDataIdx = 0;
+    auto nextVariantData = [&](uint32_t defaultValue) {
+        return (variantDataIdx < variant.data.size())
+            ? variant.data[variantDataIdx++]
+            : defaultValue
+        ;
+    };
 
+    vector<vk::DynamicState> dynamicStates;
+
+    vk::Viewport viewport;
     vk::Rect2D scissor;
-    scissor.extent = m_size;
 
     vk::PipelineViewportStateCreateInfo viewportState;
     viewportState.viewportCount = 1;
-    viewportState.pViewports = &viewport;
     viewportState.scissorCount = 1;
-    viewportState.pScissors = &scissor;
+    if (m_dynamicSize)
+    {
+        dynamicStates.push_back(vk::DynamicState::eViewport);
+        dynamicStates.push_back(vk::DynamicState::eScissor);
+    }
+    else
+    {
+        scissor.extent.width = nextVariantData(0);
+        scissor.extent.height = nextVariantData(0);
+
+        viewport.width = scissor.extent.width;
+        viewport.height = scissor.extent.height;
+
+        viewportState.pViewports = &viewport;
+        viewportState.pScissors = &scissor;
+    }
+
+    auto inputAssembly = m_inputAssembly;
+    auto rasterizer = m_rasterizer;
+    if (m_extendedDynamicState)
+    {
+        dynamicStates.push_back(vk::DynamicState::eCullMode);
+        dynamicStates.push_back(vk::DynamicState::ePrimitiveTopology);
+    }
+    else
+    {
+        rasterizer.cullMode = vk::CullModeFlags(nextVariantData(static_cast<uint32_t>(rasterizer.cullMode)));
+        inputAssembly.topology = static_cast<vk::PrimitiveTopology>(nextVariantData(static_cast<uint32_t>(inputAssembly.topology)));
+    }
+
+    vk::PipelineDynamicStateCreateInfo dynamicState;
+    dynamicState.dynamicStateCount = dynamicStates.size();
+    dynamicState.pDynamicStates = dynamicStates.data();
 
     vk::PipelineMultisampleStateCreateInfo multisampling;
     multisampling.rasterizationSamples = vk::SampleCountFlagBits::e1;
@@ -102,6 +179,7 @@ void GraphicsPipeline::createPipeline()
     for (uint32_t i = 0; i < 2; ++i)
     {
         specializationInfo[i] = getSpecializationInfo(
+            variant,
             specializationShaderStageFlagBits[i],
             specializationMapEntries[i],
             specializationData[i]
@@ -120,17 +198,146 @@ void GraphicsPipeline::createPipeline()
     vertexInputInfo.pVertexAttributeDescriptions = m_vertexAttrDescrs.data();
 
     vk::GraphicsPipelineCreateInfo pipelineInfo;
+    pipelineInfo.flags = variant.createFlags;
     pipelineInfo.stageCount = 2;
     pipelineInfo.pStages = shaderStages;
     pipelineInfo.pVertexInputState = &vertexInputInfo;
-    pipelineInfo.pInputAssemblyState = &m_inputAssembly;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
     pipelineInfo.pViewportState = &viewportState;
-    pipelineInfo.pRasterizationState = &m_rasterizer;
+    pipelineInfo.pRasterizationState = &rasterizer;
     pipelineInfo.pMultisampleState = &multisampling;
     pipelineInfo.pColorBlendState = &colorBlending;
-    pipelineInfo.layout = *m_pipelineLayout;
-    pipelineInfo.renderPass = *m_renderPass;
-    m_pipeline = m_device->createGraphicsPipelineUnique(nullptr, pipelineInfo, nullptr, m_dld).value;
+    if (!dynamicStates.empty())
+        pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = pipelineLayout;
+
+    vk::PipelineRenderingCreateInfo renderingCreateInfo;
+    if (m_renderPass)
+    {
+        pipelineInfo.renderPass = *m_renderPass;
+    }
+    else
+    {
+        renderingCreateInfo.colorAttachmentCount = 1;
+        renderingCreateInfo.pColorAttachmentFormats = &m_colorFormat;
+        pipelineInfo.pNext = &renderingCreateInfo;
+    }
+
+    program.shaderStages = {vk::ShaderStageFlagBits::eVertex, vk::ShaderStageFlagBits::eFragment};
+
+    vk::PipelineCreationFeedbackCreateInfo creationFeedbackCreateInfo;
+    prepareCreationFeedback(program, creationFeedbackCreateInfo, pipelineInfo.pNext);
+
+    auto pipelineCacheLock = m_device->pipelineCache()->lockShared();
+    program.pipeline = m_device->createGraphicsPipelineUnique(*m_device->pipelineCache(), pipelineInfo, m_device->allocationCallbacks(), m_dld).value;
+    addCreationFeedback(program);
+}
+
+Pipeline::Program GraphicsPipeline::createShaders(const Variant &variant, const vector<vk::DescriptorSetLayout> &setLayouts) const
+{
+    const vk::ShaderStageFlagBits specializationShaderStageFlagBits[2] {
+        vk::ShaderStageFlagBits::eVertex,
+        vk::ShaderStageFlagBits::eFragment,
+    };
+    vector<vk::SpecializationMapEntry> specializationMapEntries[2];
+    vector<uint32_t> specializationData[2];
+    vk::SpecializationInfo specializationInfo[2];
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        specializationInfo[i] = getSpecializationInfo(
+            variant,
+            specializationShaderStageFlagBits[i],
+            specializationMapEntries[i],
+            specializationData[i]
+        );
+    }
+
+    vector<vk::ShaderCreateInfoEXT> shaderCreateInfos {
+        m_vertexShaderModule->getShaderCreateInfo(specializationInfo[0], vk::ShaderStageFlagBits::eFragment),
+        m_fragmentShaderModule->getShaderCreateInfo(specializationInfo[1]),
+    };
+    for (auto &&shaderCreateInfo : shaderCreateInfos)
+    {
+        // Linked shaders can be optimized together like in a pipeline
+        shaderCreateInfo.flags = vk::ShaderCreateFlagBitsEXT::eLinkStage;
+    }
+
+    auto program = createShaderObjects(shaderCreateInfos, setLayouts);
+
+    // Stages of enabled features must be explicitly unbound
+    const auto &features = m_device->enabledFeatures();
+    if (features.tessellationShader)
+    {
+        program.shaderStages.push_back(vk::ShaderStageFlagBits::eTessellationControl);
+        program.shaders.emplace_back();
+        program.shaderStages.push_back(vk::ShaderStageFlagBits::eTessellationEvaluation);
+        program.shaders.emplace_back();
+    }
+    if (features.geometryShader)
+    {
+        program.shaderStages.push_back(vk::ShaderStageFlagBits::eGeometry);
+        program.shaders.emplace_back();
+    }
+
+    return program;
+}
+bool GraphicsPipeline::canUseShaderObjects() const
+{
+    // Shader objects are used only with dynamic rendering
+    return (!m_renderPass && Pipeline::canUseShaderObjects());
+}
+
+void GraphicsPipeline::fillManifestEntry(PipelineManifest::Entry &entry) const
+{
+    entry.bindPoint = vk::PipelineBindPoint::eGraphics;
+    entry.shaderHashes = {m_vertexShaderModule->hash(), m_fragmentShaderModule->hash()};
+}
+
+void GraphicsPipeline::appendVariantData(vector<uint32_t> &variantData)
+{
+    // All state is dynamic for shader objects
+    if (usesShaderObjects())
+        return;
+
+    if (!m_dynamicSize)
+    {
+        variantData.push_back(m_size.width);
+        variantData.push_back(m_size.height);
+    }
+    if (!m_extendedDynamicState)
+    {
+        variantData.push_back(static_cast<uint32_t>(m_cullMode));
+        variantData.push_back(static_cast<uint32_t>(m_topology));
+    }
+}
+
+void GraphicsPipeline::setSize(const vk::Extent2D &size)
+{
+    if (m_size == size)
+        return;
+
+    m_size = size;
+    if (!m_dynamicSize && !usesShaderObjects())
+        m_mustRecreate = true;
+}
+
+void GraphicsPipeline::setCullMode(vk::CullModeFlags cullMode)
+{
+    if (m_cullMode == cullMode)
+        return;
+
+    m_cullMode = cullMode;
+    if (!m_extendedDynamicState && !usesShaderObjects())
+        m_mustRecreate = true;
+}
+void GraphicsPipeline::setPrimitiveTopology(vk::PrimitiveTopology topology)
+{
+    if (m_topology == topology)
+        return;
+
+    m_topology = topology;
+    if (!m_extendedDynamicState && !usesShaderObjects())
+        m_mustRecreate = true;
 }
 
 void GraphicsPipeline::setCustomSpecializationDataVertex(const vector<uint32_t> &data)
@@ -146,6 +353,98 @@ void GraphicsPipeline::recordCommands(const shared_ptr<CommandBuffer> &commandBu
 {
     pushConstants(commandBuffer);
     bindObjects(commandBuffer, vk::PipelineBindPoint::eGraphics);
+
+    if (!m_shaders.empty())
+    {
+        setShaderObjectsState(commandBuffer);
+        return;
+    }
+
+    if (m_dynamicSize)
+    {
+        vk::Viewport viewport;
+        viewport.width = m_size.width;
+        viewport.height = m_size.height;
+
+        vk::Rect2D scissor;
+        scissor.extent = m_size;
+
+        commandBuffer->setViewport(0, viewport, m_dld);
+        commandBuffer->setScissor(0, scissor, m_dld);
+    }
+
+    if (m_extendedDynamicState)
+    {
+        commandBuffer->setCullMode(m_cullMode, m_dld);
+        commandBuffer->setPrimitiveTopology(m_topology, m_dld);
+    }
+}
+
+void GraphicsPipeline::setShaderObjectsState(const shared_ptr<CommandBuffer> &commandBuffer) const
+{
+    // Shader objects have no static state, so everything a pipeline would contain is set here
+    const auto &features = m_device->enabledFeatures();
+
+    vk::Viewport viewport;
+    viewport.width = m_size.width;
+    viewport.height = m_size.height;
+
+    vk::Rect2D scissor;
+    scissor.extent = m_size;
+
+    commandBuffer->setViewportWithCount(viewport, m_dld);
+    commandBuffer->setScissorWithCount(scissor, m_dld);
+
+    commandBuffer->setVertexInputEXT(m_vertexBindingDescrs2, m_vertexAttrDescrs2, m_dld);
+    commandBuffer->setPrimitiveTopology(m_topology, m_dld);
+    commandBuffer->setPrimitiveRestartEnable(m_inputAssembly.primitiveRestartEnable, m_dld);
+
+    commandBuffer->setRasterizerDiscardEnable(m_rasterizer.rasterizerDiscardEnable, m_dld);
+    commandBuffer->setPolygonModeEXT(m_rasterizer.polygonMode, m_dld);
+    commandBuffer->setCullMode(m_cullMode, m_dld);
+    commandBuffer->setFrontFace(m_rasterizer.frontFace, m_dld);
+    commandBuffer->setLineWidth(m_rasterizer.lineWidth, m_dld);
+    commandBuffer->setDepthBiasEnable(m_rasterizer.depthBiasEnable, m_dld);
+    if (m_rasterizer.depthBiasEnable)
+    {
+        commandBuffer->setDepthBias(
+            m_rasterizer.depthBiasConstantFactor,
+            m_rasterizer.depthBiasClamp,
+            m_rasterizer.depthBiasSlopeFactor,
+            m_dld
+        );
+    }
+    if (features.depthClamp)
+        commandBuffer->setDepthClampEnableEXT(m_rasterizer.depthClampEnable, m_dld);
+
+    const vk::SampleMask sampleMask = ~0u;
+    commandBuffer->setRasterizationSamplesEXT(vk::SampleCountFlagBits::e1, m_dld);
+    commandBuffer->setSampleMaskEXT(vk::SampleCountFlagBits::e1, sampleMask, m_dld);
+    commandBuffer->setAlphaToCoverageEnableEXT(false, m_dld);
+    if (features.alphaToOne)
+        commandBuffer->setAlphaToOneEnableEXT(false, m_dld);
+
+    commandBuffer->setDepthTestEnable(false, m_dld);
+    commandBuffer->setDepthWriteEnable(false, m_dld);
+    commandBuffer->setStencilTestEnable(false, m_dld);
+    if (features.depthBounds)
+        commandBuffer->setDepthBoundsTestEnable(false, m_dld);
+
+    if (features.logicOp)
+        commandBuffer->setLogicOpEnableEXT(false, m_dld);
+
+    const vk::Bool32 colorBlendEnable = m_colorBlendAttachment.blendEnable;
+    const vk::ColorBlendEquationEXT colorBlendEquation(
+        m_colorBlendAttachment.srcColorBlendFactor,
+        m_colorBlendAttachment.dstColorBlendFactor,
+        m_colorBlendAttachment.colorBlendOp,
+        m_colorBlendAttachment.srcAlphaBlendFactor,
+        m_colorBlendAttachment.dstAlphaBlendFactor,
+        m_colorBlendAttachment.alphaBlendOp
+    );
+    commandBuffer->setColorBlendEnableEXT(0, colorBlendEnable, m_dld);
+    commandBuffer->setColorBlendEquationEXT(0, colorBlendEquation, m_dld);
+    commandBuffer->setColorWriteMaskEXT(0, m_colorBlendAttachment.colorWriteMask, m_dld);
 }
 
 }
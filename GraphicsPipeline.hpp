@@ -27,8 +27,10 @@ public:
         shared_ptr<Device> device;
         shared_ptr<ShaderModule> vertexShaderModule;
         shared_ptr<ShaderModule> fragmentShaderModule;
-        shared_ptr<RenderPass> renderPass;
+        shared_ptr<RenderPass> renderPass; // "nullptr" for dynamic rendering
         vk::Extent2D size;
+        // Required for dynamic rendering
+        vk::Format colorFormat = vk::Format::eUndefined;
         // Optional
         uint32_t pushConstantsSize = 0;
         vector<vk::VertexInputBindingDescription> vertexBindingDescrs;
@@ -36,6 +38,9 @@ public:
         vk::PipelineColorBlendAttachmentState *colorBlendAttachment = nullptr;
         vk::PipelineInputAssemblyStateCreateInfo *inputAssembly = nullptr;
         vk::PipelineRasterizationStateCreateInfo *rasterizer = nullptr;
+        // Viewport and scissor are set while recording, so "setSize()" doesn't need a new pipeline.
+        // Cull mode and topology are also set while recording if extended dynamic state is available.
+        bool dynamicSize = false;
     };
 
 public:
@@ -46,30 +51,63 @@ public:
     ~GraphicsPipeline();
 
 private:
-    void createPipeline() override;
+    void createPipeline(const Variant &variant, vk::PipelineLayout pipelineLayout, Program &program) const override;
+    Program createShaders(const Variant &variant, const vector<vk::DescriptorSetLayout> &setLayouts) const override;
+    bool canUseShaderObjects() const override;
+    void fillManifestEntry(PipelineManifest::Entry &entry) const override;
+    void appendVariantData(vector<uint32_t> &variantData) override;
 
 public:
+    inline bool hasDynamicSize() const;
+    inline bool hasExtendedDynamicState() const;
+
     inline vk::Extent2D size() const;
+    void setSize(const vk::Extent2D &size);
+
+    void setCullMode(vk::CullModeFlags cullMode);
+    void setPrimitiveTopology(vk::PrimitiveTopology topology);
 
     void setCustomSpecializationDataVertex(const vector<uint32_t> &data);
     void setCustomSpecializationDataFragment(const vector<uint32_t> &data);
 
     void recordCommands(const shared_ptr<CommandBuffer> &commandBuffer);
 
+private:
+    void setShaderObjectsState(const shared_ptr<CommandBuffer> &commandBuffer) const;
+
 private:
     const shared_ptr<ShaderModule> m_vertexShaderModule;
     const shared_ptr<ShaderModule> m_fragmentShaderModule;
     const shared_ptr<RenderPass> m_renderPass;
-    const vk::Extent2D m_size;
+    const vk::Format m_colorFormat;
+    const bool m_dynamicSize;
+    const bool m_extendedDynamicState;
     const vector<vk::VertexInputBindingDescription> m_vertexBindingDescrs;
     const vector<vk::VertexInputAttributeDescription> m_vertexAttrDescrs;
     vk::PipelineColorBlendAttachmentState m_colorBlendAttachment;
     vk::PipelineInputAssemblyStateCreateInfo m_inputAssembly;
     vk::PipelineRasterizationStateCreateInfo m_rasterizer;
+
+    // Vertex input for shader objects
+    vector<vk::VertexInputBindingDescription2EXT> m_vertexBindingDescrs2;
+    vector<vk::VertexInputAttributeDescription2EXT> m_vertexAttrDescrs2;
+
+    vk::Extent2D m_size;
+    vk::CullModeFlags m_cullMode;
+    vk::PrimitiveTopology m_topology;
 };
 
 /* Inline implementation */
 
+bool GraphicsPipeline::hasDynamicSize() const
+{
+    return m_dynamicSize;
+}
+bool GraphicsPipeline::hasExtendedDynamicState() const
+{
+    return m_extendedDynamicState;
+}
+
 vk::Extent2D GraphicsPipeline::size() const
 {
     return m_size;
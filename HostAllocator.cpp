@@ -0,0 +1,304 @@
+// SPDX-License-Identifier: MIT
+/*
+   QmVk - simple Vulkan library created for QMPlay2
+   Copyright (C) 2020-2025 Błażej Szczygieł
+*/
+
+#include "HostAllocator.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace QmVk {
+
+constexpr size_t g_minSizeClass = 64;
+constexpr uint32_t g_numSizeClasses = 11; // up to 64 KiB
+
+constexpr size_t g_minArenaSize = 64 * 1024;
+constexpr size_t g_maxArenaSize = 1024 * 1024;
+
+struct HostAllocator::Header
+{
+    void *block;
+    size_t blockSize;
+    size_t size;
+    vk::SystemAllocationScope scope;
+};
+
+static uint32_t getSizeClass(size_t size)
+{
+    uint32_t sizeClass = 0;
+    while (sizeClass < g_numSizeClasses && (g_minSizeClass << sizeClass) < size)
+        ++sizeClass;
+    return sizeClass;
+}
+
+static size_t alignSize(size_t size, size_t alignment)
+{
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+HostAllocator::HostAllocator()
+{
+    m_callbacks.pUserData = this;
+    m_callbacks.pfnAllocation = allocationCallback;
+    m_callbacks.pfnReallocation = reallocationCallback;
+    m_callbacks.pfnFree = freeCallback;
+    m_callbacks.pfnInternalAllocation = internalAllocationCallback;
+    m_callbacks.pfnInternalFree = internalFreeCallback;
+}
+HostAllocator::~HostAllocator()
+{}
+
+void *HostAllocator::allocateBlock(size_t size, vk::SystemAllocationScope scope)
+{
+    (void)scope;
+    return malloc(size);
+}
+void HostAllocator::freeBlock(void *block, size_t size, vk::SystemAllocationScope scope)
+{
+    (void)size;
+    (void)scope;
+    ::free(block);
+}
+
+void *HostAllocator::allocate(size_t size, size_t alignment, vk::SystemAllocationScope scope)
+{
+    if (size == 0)
+        return nullptr;
+
+    // The header is stored directly before the returned memory
+    alignment = max(alignment, alignof(Header));
+    const size_t blockSize = sizeof(Header) + alignment - 1 + size;
+
+    auto block = allocateBlock(blockSize, scope);
+    if (!block)
+        return nullptr;
+
+    auto memory = reinterpret_cast<void *>(alignSize(reinterpret_cast<uintptr_t>(block) + sizeof(Header), alignment));
+
+    auto header = static_cast<Header *>(memory) - 1;
+    header->block = block;
+    header->blockSize = blockSize;
+    header->size = size;
+    header->scope = scope;
+
+    const size_t allocatedBytes = (m_allocatedBytes += size);
+    size_t peakAllocatedBytes = m_peakAllocatedBytes;
+    while (allocatedBytes > peakAllocatedBytes && !m_peakAllocatedBytes.compare_exchange_weak(peakAllocatedBytes, allocatedBytes));
+    ++m_numAllocations;
+
+    return memory;
+}
+void *HostAllocator::reallocate(void *original, size_t size, size_t alignment, vk::SystemAllocationScope scope)
+{
+    if (!original)
+        return allocate(size, alignment, scope);
+
+    if (size == 0)
+    {
+        free(original);
+        return nullptr;
+    }
+
+    // The original memory must stay valid if the allocation fails
+    auto memory = allocate(size, alignment, scope);
+    if (!memory)
+        return nullptr;
+
+    memcpy(memory, original, min(size, (static_cast<Header *>(original) - 1)->size));
+    free(original);
+    return memory;
+}
+void HostAllocator::free(void *memory)
+{
+    if (!memory)
+        return;
+
+    const auto header = *(static_cast<Header *>(memory) - 1);
+    m_allocatedBytes -= header.size;
+    freeBlock(header.block, header.blockSize, header.scope);
+}
+
+void *HostAllocator::allocationCallback(
+    void *userData,
+    size_t size,
+    size_t alignment,
+    VkSystemAllocationScope scope)
+{
+    return static_cast<HostAllocator *>(userData)->allocate(size, alignment, static_cast<vk::SystemAllocationScope>(scope));
+}
+void *HostAllocator::reallocationCallback(
+    void *userData,
+    void *original,
+    size_t size,
+    size_t alignment,
+    VkSystemAllocationScope scope)
+{
+    return static_cast<HostAllocator *>(userData)->reallocate(original, size, alignment, static_cast<vk::SystemAllocationScope>(scope));
+}
+void HostAllocator::freeCallback(
+    void *userData,
+    void *memory)
+{
+    static_cast<HostAllocator *>(userData)->free(memory);
+}
+void HostAllocator::internalAllocationCallback(
+    void *userData,
+    size_t size,
+    VkInternalAllocationType type,
+    VkSystemAllocationScope scope)
+{
+    (void)type;
+    (void)scope;
+    static_cast<HostAllocator *>(userData)->m_internalBytes += size;
+}
+void HostAllocator::internalFreeCallback(
+    void *userData,
+    size_t size,
+    VkInternalAllocationType type,
+    VkSystemAllocationScope scope)
+{
+    (void)type;
+    (void)scope;
+    static_cast<HostAllocator *>(userData)->m_internalBytes -= size;
+}
+
+PoolHostAllocator::PoolHostAllocator()
+    : m_freeBlocks(g_numSizeClasses)
+{}
+PoolHostAllocator::~PoolHostAllocator()
+{
+    for (uint32_t sizeClass = 0; sizeClass < g_numSizeClasses; ++sizeClass)
+    {
+        for (auto &&block : m_freeBlocks[sizeClass])
+            HostAllocator::freeBlock(block, g_minSizeClass << sizeClass, vk::SystemAllocationScope::eObject);
+    }
+}
+
+void *PoolHostAllocator::allocateBlock(size_t size, vk::SystemAllocationScope scope)
+{
+    const uint32_t sizeClass = getSizeClass(size);
+    if (sizeClass >= g_numSizeClasses)
+        return HostAllocator::allocateBlock(size, scope);
+
+    {
+        lock_guard<mutex> locker(m_mutex);
+        auto &freeBlocks = m_freeBlocks[sizeClass];
+        if (!freeBlocks.empty())
+        {
+            auto block = freeBlocks.back();
+            freeBlocks.pop_back();
+            return block;
+        }
+    }
+
+    return HostAllocator::allocateBlock(g_minSizeClass << sizeClass, scope);
+}
+void PoolHostAllocator::freeBlock(void *block, size_t size, vk::SystemAllocationScope scope)
+{
+    const uint32_t sizeClass = getSizeClass(size);
+    if (sizeClass >= g_numSizeClasses)
+    {
+        HostAllocator::freeBlock(block, size, scope);
+        return;
+    }
+
+    lock_guard<mutex> locker(m_mutex);
+    m_freeBlocks[sizeClass].push_back(block);
+}
+
+/*
+ * Arena of a single thread, only the owning thread allocates from it. Blocks
+ * keep it alive, so they can be freed on any thread, also after the owning
+ * thread has exited.
+ */
+struct Arena
+{
+    unique_ptr<uint8_t[]> data;
+    size_t capacity = 0;
+    size_t offset = 0;
+    atomic<uint32_t> refs {1}; // owning thread and allocated blocks
+};
+
+static void releaseArena(Arena *arena)
+{
+    if (--arena->refs == 0)
+        delete arena;
+}
+
+struct ThreadArena
+{
+    Arena *arena = new Arena;
+
+    ~ThreadArena()
+    {
+        releaseArena(arena);
+    }
+};
+static thread_local ThreadArena g_threadArena;
+
+// Command scope blocks are prefixed by the owning arena, "nullptr" if allocated from the pool
+constexpr size_t g_arenaPrefixSize = alignof(max_align_t);
+static_assert(sizeof(Arena *) <= g_arenaPrefixSize);
+
+ArenaHostAllocator::ArenaHostAllocator()
+{}
+ArenaHostAllocator::~ArenaHostAllocator()
+{}
+
+void *ArenaHostAllocator::allocateBlock(size_t size, vk::SystemAllocationScope scope)
+{
+    if (scope != vk::SystemAllocationScope::eCommand)
+        return PoolHostAllocator::allocateBlock(size, scope);
+
+    auto arena = g_threadArena.arena;
+    const size_t alignedSize = alignSize(g_arenaPrefixSize + size, alignof(max_align_t));
+
+    // The arena can be rewound or grown only if it's empty, because blocks can't be moved
+    if (arena->refs == 1)
+    {
+        arena->offset = 0;
+        if (alignedSize > arena->capacity && alignedSize <= g_maxArenaSize)
+        {
+            arena->capacity = min(max({arena->capacity * 2, alignedSize, g_minArenaSize}), g_maxArenaSize);
+            arena->data.reset(new uint8_t[arena->capacity]);
+        }
+    }
+
+    Arena *owner = nullptr;
+    uint8_t *data = nullptr;
+    if (arena->offset + alignedSize <= arena->capacity)
+    {
+        data = arena->data.get() + arena->offset;
+        arena->offset += alignedSize;
+        ++arena->refs;
+        owner = arena;
+    }
+    else
+    {
+        data = static_cast<uint8_t *>(PoolHostAllocator::allocateBlock(g_arenaPrefixSize + size, scope));
+        if (!data)
+            return nullptr;
+    }
+
+    *reinterpret_cast<Arena **>(data) = owner;
+    return data + g_arenaPrefixSize;
+}
+void ArenaHostAllocator::freeBlock(void *block, size_t size, vk::SystemAllocationScope scope)
+{
+    if (scope != vk::SystemAllocationScope::eCommand)
+    {
+        PoolHostAllocator::freeBlock(block, size, scope);
+        return;
+    }
+
+    auto data = static_cast<uint8_t *>(block) - g_arenaPrefixSize;
+    if (auto owner = *reinterpret_cast<Arena **>(data))
+        releaseArena(owner);
+    else
+        PoolHostAllocator::freeBlock(data, g_arenaPrefixSize + size, scope);
+}
+
+}
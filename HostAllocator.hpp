@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: MIT
+/*
+   QmVk - simple Vulkan library created for QMPlay2
+   Copyright (C) 2020-2025 Błażej Szczygieł
+*/
+
+#pragma once
+
+#include "QmVkExport.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace QmVk {
+
+using namespace std;
+
+/*
+ * Host memory allocator for the driver, set at device creation and used by
+ * all "create*()", "allocate*()" and "destroy*()" calls of the device. The
+ * base class allocates with "malloc()" and counts the allocations.
+ */
+class QMVK_EXPORT HostAllocator
+{
+    struct Header;
+
+public:
+    HostAllocator();
+    virtual ~HostAllocator();
+
+public:
+    inline const vk::AllocationCallbacks *callbacks() const;
+
+    // Bytes requested by the driver, without the allocator overhead
+    inline size_t allocatedBytes() const;
+    inline size_t peakAllocatedBytes() const;
+    inline uint64_t numAllocations() const;
+
+    // Bytes allocated by the driver on its own, e.g. executable memory
+    inline size_t internalBytes() const;
+
+protected:
+    // Blocks must be aligned at least to "alignof(max_align_t)"
+    virtual void *allocateBlock(size_t size, vk::SystemAllocationScope scope);
+    virtual void freeBlock(void *block, size_t size, vk::SystemAllocationScope scope);
+
+private:
+    void *allocate(size_t size, size_t alignment, vk::SystemAllocationScope scope);
+    void *reallocate(void *original, size_t size, size_t alignment, vk::SystemAllocationScope scope);
+    void free(void *memory);
+
+    static VKAPI_ATTR void *VKAPI_CALL allocationCallback(
+        void *userData,
+        size_t size,
+        size_t alignment,
+        VkSystemAllocationScope scope
+    );
+    static VKAPI_ATTR void *VKAPI_CALL reallocationCallback(
+        void *userData,
+        void *original,
+        size_t size,
+        size_t alignment,
+        VkSystemAllocationScope scope
+    );
+    static VKAPI_ATTR void VKAPI_CALL freeCallback(
+        void *userData,
+        void *memory
+    );
+    static VKAPI_ATTR void VKAPI_CALL internalAllocationCallback(
+        void *userData,
+        size_t size,
+        VkInternalAllocationType type,
+        VkSystemAllocationScope scope
+    );
+    static VKAPI_ATTR void VKAPI_CALL internalFreeCallback(
+        void *userData,
+        size_t size,
+        VkInternalAllocationType type,
+        VkSystemAllocationScope scope
+    );
+
+private:
+    vk::AllocationCallbacks m_callbacks;
+
+    atomic<size_t> m_allocatedBytes {0};
+    atomic<size_t> m_peakAllocatedBytes {0};
+    atomic<uint64_t> m_numAllocations {0};
+    atomic<size_t> m_internalBytes {0};
+};
+
+/*
+ * Keeps freed blocks in free lists of power of two size classes, so objects
+ * created and destroyed every frame reuse the same memory instead of going
+ * to the process allocator. Large blocks are allocated directly.
+ */
+class QMVK_EXPORT PoolHostAllocator : public HostAllocator
+{
+public:
+    PoolHostAllocator();
+    ~PoolHostAllocator();
+
+protected:
+    void *allocateBlock(size_t size, vk::SystemAllocationScope scope) override;
+    void freeBlock(void *block, size_t size, vk::SystemAllocationScope scope) override;
+
+private:
+    mutex m_mutex;
+    vector<vector<void *>> m_freeBlocks; // for each size class
+};
+
+/*
+ * Command scope allocations live only during a single Vulkan call, so they're
+ * taken from a thread-local arena which is rewound once all of them are freed.
+ * Blocks remember their arena, so the driver can free them on any thread.
+ * Other allocations use the pool.
+ */
+class QMVK_EXPORT ArenaHostAllocator : public PoolHostAllocator
+{
+public:
+    ArenaHostAllocator();
+    ~ArenaHostAllocator();
+
+protected:
+    void *allocateBlock(size_t size, vk::SystemAllocationScope scope) override;
+    void freeBlock(void *block, size_t size, vk::SystemAllocationScope scope) override;
+};
+
+/* Inline implementation */
+
+const vk::AllocationCallbacks *HostAllocator::callbacks() const
+{
+    return &m_callbacks;
+}
+
+size_t HostAllocator::allocatedBytes() const
+{
+    return m_allocatedBytes;
+}
+size_t HostAllocator::peakAllocatedBytes() const
+{
+    return m_peakAllocatedBytes;
+}
+uint64_t HostAllocator::numAllocations() const
+{
+    return m_numAllocations;
+}
+
+size_t HostAllocator::internalBytes() const
+{
+    return m_internalBytes;
+}
+
+}
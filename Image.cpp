@@ -10,6 +10,7 @@
 #include "Device.hpp"
 #include "MemoryPropertyFlags.hpp"
 #include "CommandBuffer.hpp"
+#include "BarrierBatch.hpp"
 #ifdef QMVK_USE_IMAGE_BUFFER_VIEW
 #   include "Buffer.hpp"
 #   include "BufferView.hpp"
@@ -257,13 +258,16 @@ Image::Image(
 Image::~Image()
 {
     unmap();
-    for (auto &&imageView : m_imageViews)
-        m_device->destroyImageView(imageView, nullptr, dld());
-    if (!m_externalImage)
-    {
-        for (auto &&image : m_images)
-            m_device->destroyImage(image, nullptr, dld());
-    }
+
+    if (m_externalImage)
+        m_images.clear();
+
+    m_device->deferRelease([device = m_device.get(), imageViews = move(m_imageViews), images = move(m_images)] {
+        for (auto &&imageView : imageViews)
+            device->destroyImageView(imageView, device->allocationCallbacks(), device->dld());
+        for (auto &&image : images)
+            device->destroyImage(image, device->allocationCallbacks(), device->dld());
+    });
 }
 
 void Image::init(
@@ -425,7 +429,7 @@ void Image::init(
         if (imageCreateInfoCallback)
             imageCreateInfoCallback(i, imageCreateInfo);
 
-        m_images[i] = m_device->createImage(imageCreateInfo, nullptr, dld());
+        m_images[i] = m_device->createImage(imageCreateInfo, m_device->allocationCallbacks(), dld());
     }
 
     allocateAndBindMemory(memoryPropertyPreset, heap);
@@ -458,7 +462,7 @@ void Image::allocateAndBindMemory(MemoryPropertyPreset memoryPropertyPreset, uin
             imageMemoryRequirementsInfo2.image = m_images[0];
             imageMemoryRequirementsInfo2.pNext = &imagePlaneMemReqInfo;
 
-            memoryRequirements2 = m_device->getImageMemoryRequirements2KHR(imageMemoryRequirementsInfo2, dld());
+            memoryRequirements2 = m_device->getImageMemoryRequirements2(imageMemoryRequirementsInfo2, dld());
         }
         else
         {
@@ -484,7 +488,7 @@ void Image::allocateAndBindMemory(MemoryPropertyPreset memoryPropertyPreset, uin
         vk::BufferCreateInfo bufferCreateInfo;
         bufferCreateInfo.usage = vk::BufferUsageFlagBits::eUniformTexelBuffer | vk::BufferUsageFlagBits::eStorageTexelBuffer;
         bufferCreateInfo.size = m_memoryRequirements.size;
-        m_uniqueBuffer = m_device->createBufferUnique(bufferCreateInfo, nullptr, dld());
+        m_uniqueBuffer = m_device->createBufferUnique(bufferCreateInfo, m_device->allocationCallbacks(), dld());
 
         m_memoryRequirements.alignment = max(
             m_memoryRequirements.alignment,
@@ -558,7 +562,7 @@ void Image::allocateAndBindMemory(MemoryPropertyPreset memoryPropertyPreset, uin
             break;
     }
     memoryPropertyFlags.heap = heap;
-    allocateMemory(memoryPropertyFlags);
+    allocateMemory(memoryPropertyFlags, m_linear);
 
     if (m_ycbcr)
     {
@@ -570,14 +574,14 @@ void Image::allocateAndBindMemory(MemoryPropertyPreset memoryPropertyPreset, uin
 
             bindImageMemInfos[i].image = m_images[0];
             bindImageMemInfos[i].memory = deviceMemory();
-            bindImageMemInfos[i].memoryOffset = memoryOffsets[i];
+            bindImageMemInfos[i].memoryOffset = deviceMemoryOffset() + memoryOffsets[i];
             bindImageMemInfos[i].pNext = &bindImagePlaneMemInfos[i];
         }
-        m_device->bindImageMemory2KHR(bindImageMemInfos, dld());
+        m_device->bindImageMemory2(bindImageMemInfos, dld());
     }
     else for (uint32_t i = 0; i < m_numImages; ++i)
     {
-        m_device->bindImageMemory(m_images[i], deviceMemory(), memoryOffsets[i], dld());
+        m_device->bindImageMemory(m_images[i], deviceMemory(), deviceMemoryOffset() + memoryOffsets[i], dld());
     }
 }
 
@@ -598,7 +602,7 @@ void Image::recreateImageViews(vk::SamplerYcbcrConversion samperYcbcr)
 {
     for (auto &&imageView : m_imageViews)
     {
-        m_device->destroyImageView(imageView, nullptr, dld());
+        m_device->destroyImageView(imageView, m_device->allocationCallbacks(), dld());
         imageView = nullptr;
     }
 
@@ -618,7 +622,7 @@ void Image::recreateImageViews(vk::SamplerYcbcrConversion samperYcbcr)
         imageViewCreateInfo.format = m_mainFormat;
         imageViewCreateInfo.subresourceRange = getImageSubresourceRange();
         imageViewCreateInfo.pNext = &samplerYcbcrInfo;
-        m_imageViews[0] = m_device->createImageView(imageViewCreateInfo, nullptr, dld());
+        m_imageViews[0] = m_device->createImageView(imageViewCreateInfo, m_device->allocationCallbacks(), dld());
 
         m_samperYcbcr = samperYcbcr;
     }
@@ -634,7 +638,7 @@ void Image::recreateImageViews(vk::SamplerYcbcrConversion samperYcbcr)
             imageViewCreateInfo.viewType = vk::ImageViewType::e2D;
             imageViewCreateInfo.format = m_formats[i];
             imageViewCreateInfo.subresourceRange = getImageSubresourceRange(~0u, m_ycbcr ? i : ~0u);
-            m_imageViews[i] = m_device->createImageView(imageViewCreateInfo, nullptr, dld());
+            m_imageViews[i] = m_device->createImageView(imageViewCreateInfo, m_device->allocationCallbacks(), dld());
         }
     }
 
@@ -655,7 +659,8 @@ shared_ptr<BufferView> Image::bufferView(uint32_t plane)
             vk::BufferUsageFlagBits::eUniformTexelBuffer | vk::BufferUsageFlagBits::eStorageTexelBuffer,
             deviceMemory(),
             m_memoryPropertyFlags,
-            &m_uniqueBuffer
+            &m_uniqueBuffer,
+            deviceMemoryOffset()
         );
 
         m_bufferViews.reserve(m_numPlanes);
@@ -737,12 +742,14 @@ bool Image::setMipLevelsLimitForSize(const vk::Extent2D &size)
 
 void *Image::map(uint32_t plane)
 {
+    flushTransferBatch();
+
     if (!m_mapped)
     {
         if (m_externalImport || m_externalImage)
             throw vk::LogicError("Can't map externally imported memory or image");
 
-        m_mapped = m_device->mapMemory(deviceMemory(), 0, memorySize(), {}, dld());
+        m_mapped = mapDeviceMemory();
     }
 
     if (plane == ~0u)
@@ -755,7 +762,7 @@ void Image::unmap()
     if (!m_mapped)
         return;
 
-    m_device->unmapMemory(deviceMemory(), dld());
+    unmapDeviceMemory();
     m_mapped = nullptr;
 }
 
@@ -773,18 +780,24 @@ void Image::copyTo(
         throw vk::LogicError("Source image and destination image format missmatch");
 
     auto copyCommands = [&](vk::CommandBuffer commandBuffer) {
+        BarrierBatch barrierBatch(commandBuffer, *m_device);
         pipelineBarrier(
-            commandBuffer,
+            barrierBatch,
             vk::ImageLayout::eTransferSrcOptimal,
             vk::PipelineStageFlagBits::eTransfer,
-            vk::AccessFlagBits::eTransferRead
+            vk::AccessFlagBits::eTransferRead,
+            vk::PipelineStageFlagBits2::eCopy,
+            vk::AccessFlagBits2::eTransferRead
         );
         dstImage->pipelineBarrier(
-            commandBuffer,
+            barrierBatch,
             vk::ImageLayout::eTransferDstOptimal,
             vk::PipelineStageFlagBits::eTransfer,
-            vk::AccessFlagBits::eTransferWrite
+            vk::AccessFlagBits::eTransferWrite,
+            vk::PipelineStageFlagBits2::eCopy,
+            vk::AccessFlagBits2::eTransferWrite
         );
+        barrierBatch.flush();
 
         for (uint32_t i = 0; i < m_numPlanes; ++i)
         {
@@ -820,7 +833,7 @@ void Image::copyTo(
     }
     else
     {
-        internalCommandBuffer()->execute(copyCommands);
+        executeInternal(copyCommands, {shared_from_this(), dstImage});
     }
 }
 
@@ -830,6 +843,48 @@ void Image::maybeGenerateMipmaps(const shared_ptr<CommandBuffer> &commandBuffer)
         commandBuffer->storeData(shared_from_this());
 }
 
+vk::ImageLayout Image::imageLayout() const
+{
+    for (auto &&state : m_subresourceStates)
+    {
+        if (state.layout != m_subresourceStates[0].layout)
+            throw vk::LogicError("Image subresources are in different layouts");
+    }
+    return m_subresourceStates.empty() ? m_imageLayout : m_subresourceStates[0].layout;
+}
+vk::PipelineStageFlags Image::stage() const
+{
+    if (m_subresourceStates.empty())
+        return m_stage;
+
+    vk::PipelineStageFlags stage;
+    for (auto &&state : m_subresourceStates)
+        stage |= state.stage;
+    return stage;
+}
+vk::AccessFlags Image::accessFlags() const
+{
+    if (m_subresourceStates.empty())
+        return m_accessFlags;
+
+    vk::AccessFlags accessFlags;
+    for (auto &&state : m_subresourceStates)
+        accessFlags |= state.accessFlags;
+    return accessFlags;
+}
+
+void Image::setState(
+    vk::ImageLayout imageLayout,
+    vk::PipelineStageFlags stage,
+    vk::AccessFlags accessFlags)
+{
+    m_imageLayout = imageLayout;
+    m_stage = stage;
+    m_accessFlags = accessFlags;
+    m_state2.setDst(BarrierBatch::Masks2(), stage, accessFlags);
+    m_subresourceStates.clear();
+}
+
 void Image::fetchSubresourceLayouts()
 {
     for (uint32_t i = 0; i < m_numPlanes; ++i)
@@ -847,47 +902,46 @@ bool Image::maybeGenerateMipmaps(vk::CommandBuffer commandBuffer)
     if (!m_useMipMaps || m_mipLevels <= 1)
         return false;
 
-    vk::ImageSubresourceRange imageSubresourceRange = getImageSubresourceRange(1);
-
     auto mipSizes = m_sizes;
 
-    vk::ImageLayout imageLayout = m_imageLayout;
-    vk::PipelineStageFlags stage = m_stage;
-    vk::AccessFlags accessFlags = m_accessFlags;
+    BarrierBatch::Masks2 blitSrcMasks2;
+    blitSrcMasks2.dstStage = vk::PipelineStageFlagBits2::eBlit;
+    blitSrcMasks2.dstAccess = vk::AccessFlagBits2::eTransferRead;
+
+    BarrierBatch::Masks2 blitDstMasks2;
+    blitDstMasks2.dstStage = vk::PipelineStageFlagBits2::eBlit;
+    blitDstMasks2.dstAccess = vk::AccessFlagBits2::eTransferWrite;
+
+    const auto transferSrcLayout = vk::ImageLayout::eTransferSrcOptimal;
+    const auto transferDstLayout = vk::ImageLayout::eTransferDstOptimal;
 
     m_mipLevelsGenerated = 1;
 
     for (uint32_t l = 1; l < m_mipLevels; ++l)
     {
-        imageSubresourceRange.baseMipLevel = l - 1;
+        // Only the source and the destination levels are transitioned
+        BarrierBatch barrierBatch(commandBuffer, *m_device);
         pipelineBarrier(
-            commandBuffer,
-            imageLayout,
-            vk::ImageLayout::eTransferSrcOptimal,
-            stage,
+            barrierBatch,
+            ~0u,
+            l - 1,
+            1,
+            &transferSrcLayout,
             vk::PipelineStageFlagBits::eTransfer,
-            accessFlags,
             vk::AccessFlagBits::eTransferRead,
-            imageSubresourceRange,
-            false
+            blitSrcMasks2
         );
-
-        imageSubresourceRange.baseMipLevel = l;
         pipelineBarrier(
-            commandBuffer,
-            m_imageLayout,
-            vk::ImageLayout::eTransferDstOptimal,
-            m_stage,
+            barrierBatch,
+            ~0u,
+            l,
+            1,
+            &transferDstLayout,
             vk::PipelineStageFlagBits::eTransfer,
-            m_accessFlags,
             vk::AccessFlagBits::eTransferWrite,
-            imageSubresourceRange,
-            false
+            blitDstMasks2
         );
-
-        imageLayout = vk::ImageLayout::eTransferDstOptimal;
-        stage = vk::PipelineStageFlagBits::eTransfer;
-        accessFlags = vk::AccessFlagBits::eTransferWrite;
+        barrierBatch.flush();
 
         if (l >= m_mipLevelsLimit)
             continue;
@@ -930,18 +984,18 @@ bool Image::maybeGenerateMipmaps(vk::CommandBuffer commandBuffer)
         ++m_mipLevelsGenerated;
     }
 
-    imageSubresourceRange.baseMipLevel = m_mipLevels - 1;
+    BarrierBatch barrierBatch(commandBuffer, *m_device);
     pipelineBarrier(
-        commandBuffer,
-        imageLayout,
-        vk::ImageLayout::eTransferSrcOptimal,
-        stage,
+        barrierBatch,
+        ~0u,
+        m_mipLevels - 1,
+        1,
+        &transferSrcLayout,
         vk::PipelineStageFlagBits::eTransfer,
-        accessFlags,
         vk::AccessFlagBits::eTransferRead,
-        imageSubresourceRange,
-        true
+        blitSrcMasks2
     );
+    barrierBatch.flush();
 
     return true;
 }
@@ -964,6 +1018,37 @@ vk::ImageSubresourceRange Image::getImageSubresourceRange(uint32_t mipLevels, ui
     return imageSubresourceRange;
 }
 
+void Image::splitSubresourceStates()
+{
+    if (!m_subresourceStates.empty())
+        return;
+
+    SubresourceState state;
+    state.layout = m_imageLayout;
+    state.stage = m_stage;
+    state.accessFlags = m_accessFlags;
+    state.state2 = m_state2;
+    m_subresourceStates.resize(m_numPlanes * m_mipLevels, state);
+}
+void Image::mergeSubresourceStates()
+{
+    if (m_subresourceStates.empty())
+        return;
+
+    const auto &state = m_subresourceStates[0];
+    for (auto &&otherState : m_subresourceStates)
+    {
+        if (!(otherState == state))
+            return;
+    }
+
+    m_imageLayout = state.layout;
+    m_stage = state.stage;
+    m_accessFlags = state.accessFlags;
+    m_state2 = state.state2;
+    m_subresourceStates.clear();
+}
+
 inline bool Image::mustExecPipelineBarrier(
     vk::ImageLayout newLayout,
     vk::PipelineStageFlags dstStage,
@@ -978,64 +1063,153 @@ void Image::pipelineBarrier(
     vk::PipelineStageFlags dstStage,
     vk::AccessFlags dstAccessFlags)
 {
+    BarrierBatch barrierBatch(commandBuffer, *m_device);
+    pipelineBarrier(barrierBatch, dstImageLayout, dstStage, dstAccessFlags);
+    barrierBatch.flush();
+}
+void Image::pipelineBarrier(
+    BarrierBatch &barrierBatch,
+    vk::ImageLayout dstImageLayout,
+    vk::PipelineStageFlags dstStage,
+    vk::AccessFlags dstAccessFlags,
+    vk::PipelineStageFlags2 dstStage2,
+    vk::AccessFlags2 dstAccessFlags2,
+    uint32_t plane)
+{
+    BarrierBatch::Masks2 masks2;
+    masks2.dstStage = dstStage2;
+    masks2.dstAccess = dstAccessFlags2;
+
     pipelineBarrier(
-        commandBuffer,
-        m_imageLayout,
-        dstImageLayout,
-        m_stage,
+        barrierBatch,
+        plane,
+        0,
+        m_mipLevels,
+        &dstImageLayout,
         dstStage,
-        m_accessFlags,
         dstAccessFlags,
-        getImageSubresourceRange(),
-        true
+        masks2
     );
 }
 void Image::pipelineBarrier(
-    vk::CommandBuffer commandBuffer,
-    vk::ImageLayout srcImageLayout,
-    vk::ImageLayout dstImageLayout,
-    vk::PipelineStageFlags srcStage,
+    BarrierBatch &barrierBatch,
+    uint32_t plane,
+    uint32_t baseMipLevel,
+    uint32_t mipLevelCount,
+    const vk::ImageLayout *dstImageLayout,
     vk::PipelineStageFlags dstStage,
-    vk::AccessFlags srcAccessFlags,
     vk::AccessFlags dstAccessFlags,
-    const vk::ImageSubresourceRange &imageSubresourceRange,
-    bool updateVariables)
+    const BarrierBatch::Masks2 &dstMasks2)
 {
-    if (!mustExecPipelineBarrier(dstImageLayout, dstStage, dstAccessFlags))
-        return;
+    const bool allPlanes = (plane == ~0u || m_numPlanes == 1);
+    const bool allMipLevels = (baseMipLevel == 0 && mipLevelCount >= m_mipLevels);
 
-    for (auto &&image : m_images)
+    if (allPlanes && allMipLevels && m_subresourceStates.empty())
     {
-        vk::ImageMemoryBarrier barrier(
-            srcAccessFlags,
-            dstAccessFlags,
-            srcImageLayout,
-            dstImageLayout,
-            VK_QUEUE_FAMILY_IGNORED,
-            VK_QUEUE_FAMILY_IGNORED,
-            image,
-            imageSubresourceRange
-        );
-        commandBuffer.pipelineBarrier(
-            srcStage,
-            dstStage,
-            vk::DependencyFlags(),
-            0,
-            nullptr,
-            0,
-            nullptr,
-            1,
-            &barrier,
-            dld()
-        );
-    }
+        // Fast path - the whole image is in the same state
+        const auto newLayout = dstImageLayout ? *dstImageLayout : m_imageLayout;
+        if (!mustExecPipelineBarrier(newLayout, dstStage, dstAccessFlags))
+            return;
 
-    if (updateVariables)
-    {
-        m_imageLayout = dstImageLayout;
+        auto masks2 = dstMasks2;
+        m_state2.setSrc(masks2, m_stage, m_accessFlags);
+
+        for (auto &&image : m_images)
+        {
+            vk::ImageMemoryBarrier barrier(
+                m_accessFlags,
+                dstAccessFlags,
+                m_imageLayout,
+                newLayout,
+                VK_QUEUE_FAMILY_IGNORED,
+                VK_QUEUE_FAMILY_IGNORED,
+                image,
+                getImageSubresourceRange()
+            );
+            barrierBatch.addImageBarrier(m_stage, dstStage, barrier, masks2);
+        }
+
+        m_state2.setDst(masks2, dstStage, dstAccessFlags);
+        m_imageLayout = newLayout;
         m_stage = dstStage;
         m_accessFlags = dstAccessFlags;
+        return;
     }
+
+    splitSubresourceStates();
+
+    const uint32_t firstPlane = allPlanes ? 0 : plane;
+    const uint32_t lastPlane = allPlanes ? m_numPlanes : plane + 1;
+    const uint32_t endMipLevel = min(baseMipLevel + mipLevelCount, m_mipLevels);
+
+    for (uint32_t p = firstPlane; p < lastPlane; ++p)
+    {
+        auto states = m_subresourceStates.data() + p * m_mipLevels;
+
+        uint32_t mipLevel = baseMipLevel;
+        while (mipLevel < endMipLevel)
+        {
+            const auto state = states[mipLevel];
+            const auto newLayout = dstImageLayout ? *dstImageLayout : state.layout;
+
+            if (state.layout == newLayout && state.stage == dstStage && state.accessFlags == dstAccessFlags)
+            {
+                ++mipLevel;
+                continue;
+            }
+
+            // Consecutive mip levels in the same state are transitioned by a single barrier
+            uint32_t levelCount = 1;
+            while (mipLevel + levelCount < endMipLevel && states[mipLevel + levelCount] == state)
+                ++levelCount;
+
+            auto masks2 = dstMasks2;
+            state.state2.setSrc(masks2, state.stage, state.accessFlags);
+
+            // Planes of a multi-planar image are transitioned separately by their aspects
+            auto imageSubresourceRange = getImageSubresourceRange(levelCount, m_ycbcr ? p : ~0u);
+            imageSubresourceRange.baseMipLevel = mipLevel;
+
+            vk::ImageMemoryBarrier barrier(
+                state.accessFlags,
+                dstAccessFlags,
+                state.layout,
+                newLayout,
+                VK_QUEUE_FAMILY_IGNORED,
+                VK_QUEUE_FAMILY_IGNORED,
+                m_images[m_ycbcr ? 0 : p],
+                imageSubresourceRange
+            );
+            barrierBatch.addImageBarrier(state.stage, dstStage, barrier, masks2);
+
+            for (uint32_t l = mipLevel; l < mipLevel + levelCount; ++l)
+            {
+                auto &newState = states[l];
+                newState.layout = newLayout;
+                newState.stage = dstStage;
+                newState.accessFlags = dstAccessFlags;
+                newState.state2.setDst(masks2, dstStage, dstAccessFlags);
+            }
+
+            mipLevel += levelCount;
+        }
+    }
+
+    mergeSubresourceStates();
+}
+
+void Image::resetPipelineStage(BarrierBatch &barrierBatch)
+{
+    pipelineBarrier(
+        barrierBatch,
+        ~0u,
+        0,
+        m_mipLevels,
+        nullptr,
+        vk::PipelineStageFlagBits::eBottomOfPipe,
+        vk::AccessFlags(),
+        BarrierBatch::Masks2()
+    );
 }
 
 }
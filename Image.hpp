@@ -9,6 +9,7 @@
 #include "QmVkExport.hpp"
 
 #include "MemoryObject.hpp"
+#include "BarrierBatch.hpp"
 
 #include <functional>
 
@@ -191,10 +192,21 @@ public:
 
     void maybeGenerateMipmaps(const shared_ptr<CommandBuffer> &commandBuffer);
 
-    // Modify only on external image
-    inline vk::ImageLayout &imageLayout();
-    inline vk::PipelineStageFlags &stage();
-    inline vk::AccessFlags &accessFlags();
+    // Layout of the given plane and mip level
+    inline vk::ImageLayout imageLayout(uint32_t plane, uint32_t mipLevel) const;
+
+    // Layout of the whole image, throws if subresources are in different layouts
+    vk::ImageLayout imageLayout() const;
+    // Merged stages and access flags of all subresources
+    vk::PipelineStageFlags stage() const;
+    vk::AccessFlags accessFlags() const;
+
+    // Use only on external image, sets the state of all subresources
+    void setState(
+        vk::ImageLayout imageLayout,
+        vk::PipelineStageFlags stage,
+        vk::AccessFlags accessFlags
+    );
 
 private:
     void fetchSubresourceLayouts();
@@ -205,6 +217,9 @@ private:
 
     vk::ImageSubresourceRange getImageSubresourceRange(uint32_t mipLevels = ~0u, uint32_t plane = ~0u) const;
 
+    void splitSubresourceStates();
+    void mergeSubresourceStates();
+
     inline bool mustExecPipelineBarrier(
         vk::ImageLayout dstImageLayout,
         vk::PipelineStageFlags dstStage,
@@ -218,17 +233,29 @@ private:
         vk::AccessFlags dstAccessFlags
     );
     void pipelineBarrier(
-        vk::CommandBuffer commandBuffer,
-        vk::ImageLayout srcImageLayout,
-        vk::ImageLayout dstImageLayout,
-        vk::PipelineStageFlags srcStage,
+        BarrierBatch &barrierBatch,
+        vk::ImageLayout newLayout,
+        vk::PipelineStageFlags dstStage,
+        vk::AccessFlags dstAccessFlags,
+        vk::PipelineStageFlags2 dstStage2 = {},
+        vk::AccessFlags2 dstAccessFlags2 = {},
+        uint32_t plane = ~0u
+    );
+
+    // Transitions only the given plane ("~0u" for all) and mip levels, "nullptr" layout keeps the current one
+    void pipelineBarrier(
+        BarrierBatch &barrierBatch,
+        uint32_t plane,
+        uint32_t baseMipLevel,
+        uint32_t mipLevelCount,
+        const vk::ImageLayout *dstImageLayout,
         vk::PipelineStageFlags dstStage,
-        vk::AccessFlags srcAccessFlags,
         vk::AccessFlags dstAccessFlags,
-        const vk::ImageSubresourceRange &imageSubresourceRange,
-        bool updateVariables
+        const BarrierBatch::Masks2 &dstMasks2
     );
 
+    void resetPipelineStage(BarrierBatch &barrierBatch);
+
 private:
     const vk::Extent2D m_wantedSize;
     const uint32_t m_wantedPaddingHeight;
@@ -271,6 +298,23 @@ private:
     vk::ImageLayout m_imageLayout = vk::ImageLayout::eUndefined;
     vk::PipelineStageFlags m_stage = vk::PipelineStageFlagBits::eTopOfPipe;
     vk::AccessFlags m_accessFlags;
+    BarrierBatch::State2 m_state2;
+
+    struct SubresourceState
+    {
+        vk::ImageLayout layout;
+        vk::PipelineStageFlags stage;
+        vk::AccessFlags accessFlags;
+        BarrierBatch::State2 state2;
+
+        inline bool operator==(const SubresourceState &other) const
+        {
+            return (layout == other.layout && stage == other.stage && accessFlags == other.accessFlags && state2 == other.state2);
+        }
+    };
+    // Per plane and mip level states, empty if the whole image is in the same state
+    // Planes of a multi-planar image are tracked separately, so they can be in different states
+    vector<SubresourceState> m_subresourceStates;
 };
 
 /* Inline Implementation */
@@ -377,17 +421,11 @@ vk::DeviceSize Image::linesize(uint32_t plane) const
     return m_subresourceLayouts[plane].rowPitch;
 }
 
-inline vk::ImageLayout &Image::imageLayout()
-{
-    return m_imageLayout;
-}
-inline vk::PipelineStageFlags &Image::stage()
-{
-    return m_stage;
-}
-inline vk::AccessFlags &Image::accessFlags()
+inline vk::ImageLayout Image::imageLayout(uint32_t plane, uint32_t mipLevel) const
 {
-    return m_accessFlags;
+    if (m_subresourceStates.empty())
+        return m_imageLayout;
+    return m_subresourceStates[plane * m_mipLevels + mipLevel].layout;
 }
 
 template<typename T>
@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: MIT
+/*
+   QmVk - simple Vulkan library created for QMPlay2
+   Copyright (C) 2020-2025 Błażej Szczygieł
+*/
+
+#include "LayoutCache.hpp"
+#include "DescriptorSetLayout.hpp"
+#include "Device.hpp"
+
+#include <algorithm>
+
+namespace QmVk {
+
+struct LayoutCache::PipelineLayout
+{
+    shared_ptr<DescriptorSetLayout> descriptorSetLayout;
+    vk::ShaderStageFlags pushConstantsShaderStageFlags;
+    uint32_t pushConstantsSize = 0;
+    vk::DescriptorSetLayout bindlessSetLayout;
+
+    vk::UniquePipelineLayout pipelineLayout;
+};
+
+template<typename T>
+static void removeExpired(vector<weak_ptr<T>> &entries)
+{
+    entries.erase(remove_if(entries.begin(), entries.end(), [](auto &&entry) {
+        return entry.expired();
+    }), entries.end());
+}
+
+LayoutCache::LayoutCache(Device &device)
+    : m_device(device)
+{}
+LayoutCache::~LayoutCache()
+{}
+
+shared_ptr<DescriptorSetLayout> LayoutCache::descriptorSetLayout(
+    const vector<DescriptorType> &descriptorTypes,
+    DescriptorSetLayout::Mode mode)
+{
+    lock_guard<mutex> locker(m_mutex);
+
+    removeExpired(m_descriptorSetLayouts);
+
+    for (auto &&weakDescriptorSetLayout : m_descriptorSetLayouts)
+    {
+        auto descriptorSetLayout = weakDescriptorSetLayout.lock();
+        if (descriptorSetLayout
+            && descriptorSetLayout->mode() == mode
+            && descriptorSetLayout->descriptorTypes() == descriptorTypes)
+        {
+            return descriptorSetLayout;
+        }
+    }
+
+    auto descriptorSetLayout = DescriptorSetLayout::create(
+        m_device.shared_from_this(),
+        descriptorTypes,
+        mode
+    );
+    m_descriptorSetLayouts.push_back(descriptorSetLayout);
+    return descriptorSetLayout;
+}
+
+shared_ptr<const vk::PipelineLayout> LayoutCache::pipelineLayout(
+    const shared_ptr<DescriptorSetLayout> &descriptorSetLayout,
+    vk::ShaderStageFlags pushConstantsShaderStageFlags,
+    uint32_t pushConstantsSize,
+    vk::DescriptorSetLayout bindlessSetLayout)
+{
+    lock_guard<mutex> locker(m_mutex);
+
+    removeExpired(m_pipelineLayouts);
+
+    if (pushConstantsSize == 0)
+        pushConstantsShaderStageFlags = {};
+
+    for (auto &&weakPipelineLayout : m_pipelineLayouts)
+    {
+        auto pipelineLayout = weakPipelineLayout.lock();
+        if (pipelineLayout
+            && pipelineLayout->descriptorSetLayout == descriptorSetLayout
+            && pipelineLayout->pushConstantsShaderStageFlags == pushConstantsShaderStageFlags
+            && pipelineLayout->pushConstantsSize == pushConstantsSize
+            && pipelineLayout->bindlessSetLayout == bindlessSetLayout)
+        {
+            return shared_ptr<const vk::PipelineLayout>(pipelineLayout, &*pipelineLayout->pipelineLayout);
+        }
+    }
+
+    vk::PushConstantRange pushConstantRange;
+    pushConstantRange.stageFlags = pushConstantsShaderStageFlags;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = pushConstantsSize;
+
+    const vk::DescriptorSetLayout setLayouts[] = {
+        *static_cast<const vk::DescriptorSetLayout *>(*descriptorSetLayout),
+        bindlessSetLayout,
+    };
+
+    vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
+    if (bindlessSetLayout)
+    {
+        // Set 0 must be valid, even if it's empty
+        pipelineLayoutInfo.setLayoutCount = 2;
+        pipelineLayoutInfo.pSetLayouts = setLayouts;
+    }
+    else if (!descriptorSetLayout->isEmpty())
+    {
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = setLayouts;
+    }
+    if (pushConstantRange.size > 0)
+    {
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    }
+
+    auto pipelineLayout = make_shared<PipelineLayout>();
+    pipelineLayout->descriptorSetLayout = descriptorSetLayout;
+    pipelineLayout->pushConstantsShaderStageFlags = pushConstantsShaderStageFlags;
+    pipelineLayout->pushConstantsSize = pushConstantsSize;
+    pipelineLayout->bindlessSetLayout = bindlessSetLayout;
+    pipelineLayout->pipelineLayout = m_device.createPipelineLayoutUnique(pipelineLayoutInfo, m_device.allocationCallbacks(), m_device.dld());
+    m_pipelineLayouts.push_back(pipelineLayout);
+
+    // The returned pointer keeps the whole entry alive
+    return shared_ptr<const vk::PipelineLayout>(pipelineLayout, &*pipelineLayout->pipelineLayout);
+}
+
+}
@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: MIT
+/*
+   QmVk - simple Vulkan library created for QMPlay2
+   Copyright (C) 2020-2025 Błażej Szczygieł
+*/
+
+#pragma once
+
+#include "QmVkExport.hpp"
+
+#include "DescriptorSetLayout.hpp"
+
+#include <memory>
+#include <mutex>
+
+namespace QmVk {
+
+using namespace std;
+
+class Device;
+
+/*
+ * Device-wide cache of descriptor set layouts and pipeline layouts, so
+ * pipelines with the same descriptor types and push constants share them.
+ * Layouts are destroyed when the last user releases them.
+ */
+class QMVK_EXPORT LayoutCache
+{
+    struct PipelineLayout;
+
+public:
+    LayoutCache(Device &device);
+    ~LayoutCache();
+
+public:
+    shared_ptr<DescriptorSetLayout> descriptorSetLayout(
+        const vector<DescriptorType> &descriptorTypes,
+        DescriptorSetLayout::Mode mode = DescriptorSetLayout::Mode::DescriptorSet
+    );
+
+    shared_ptr<const vk::PipelineLayout> pipelineLayout(
+        const shared_ptr<DescriptorSetLayout> &descriptorSetLayout,
+        vk::ShaderStageFlags pushConstantsShaderStageFlags,
+        uint32_t pushConstantsSize,
+        vk::DescriptorSetLayout bindlessSetLayout = nullptr // used as set 1
+    );
+
+private:
+    Device &m_device;
+
+    mutex m_mutex;
+    vector<weak_ptr<DescriptorSetLayout>> m_descriptorSetLayouts;
+    vector<weak_ptr<PipelineLayout>> m_pipelineLayouts;
+};
+
+}
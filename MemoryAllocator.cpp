@@ -0,0 +1,310 @@
+// SPDX-License-Identifier: MIT
+/*
+   QmVk - simple Vulkan library created for QMPlay2
+   Copyright (C) 2020-2025 Błażej Szczygieł
+*/
+
+#include "MemoryAllocator.hpp"
+#include "PhysicalDevice.hpp"
+#include "Device.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+
+namespace QmVk {
+
+constexpr vk::DeviceSize g_minBlockSize = 4ull * 1024ull * 1024ull;
+constexpr vk::DeviceSize g_maxBlockSize = 64ull * 1024ull * 1024ull;
+
+struct MemoryAllocator::Block
+{
+    Pool *pool = nullptr;
+
+    vk::DeviceMemory deviceMemory;
+    vk::DeviceSize size = 0;
+    vk::DeviceSize usedSize = 0;
+    uint32_t allocationCount = 0;
+
+    map<vk::DeviceSize, vk::DeviceSize> freeRanges; // {offset, size}
+
+    void *mapped = nullptr;
+    uint32_t mapCount = 0;
+};
+
+struct MemoryAllocator::Pool
+{
+    uint32_t memoryTypeIndex = 0;
+    bool deviceAddress = false;
+    vk::DeviceSize blockSize = 0;
+    vector<unique_ptr<Block>> blocks;
+};
+
+static inline vk::DeviceSize alignOffset(vk::DeviceSize offset, vk::DeviceSize alignment)
+{
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+MemoryAllocator::MemoryAllocator(Device &device)
+    : m_device(device)
+{}
+MemoryAllocator::~MemoryAllocator()
+{
+    for (auto &&pool : m_pools)
+    {
+        for (auto &&block : pool.second->blocks)
+        {
+            if (block->mapped)
+                m_device.unmapMemory(block->deviceMemory, m_device.dld());
+            m_device.freeMemory(block->deviceMemory, m_device.allocationCallbacks(), m_device.dld());
+        }
+    }
+}
+
+MemoryAllocator::Allocation MemoryAllocator::allocate(
+    uint32_t memoryTypeIndex,
+    const vk::MemoryRequirements &memoryRequirements,
+    bool linear,
+    bool deviceAddress)
+{
+    Allocation allocation;
+
+    lock_guard<mutex> locker(m_mutex);
+
+    auto &pool = getPool(memoryTypeIndex, linear, deviceAddress);
+    if (memoryRequirements.size == 0 || memoryRequirements.size > pool.blockSize / 2)
+        return allocation;
+
+    const auto alignment = max<vk::DeviceSize>(memoryRequirements.alignment, 1);
+
+    Block *bestBlock = nullptr;
+    vk::DeviceSize bestRangeOffset = 0;
+    vk::DeviceSize bestOffset = 0;
+    vk::DeviceSize bestRemaining = numeric_limits<vk::DeviceSize>::max();
+
+    // Best fit - choose the free range which leaves the least unused space
+    for (auto &&block : pool.blocks)
+    {
+        if (block->size - block->usedSize < memoryRequirements.size)
+            continue;
+
+        for (auto &&freeRange : block->freeRanges)
+        {
+            const auto offset = alignOffset(freeRange.first, alignment);
+            const auto padding = offset - freeRange.first;
+            if (padding + memoryRequirements.size > freeRange.second)
+                continue;
+
+            const auto remaining = freeRange.second - padding - memoryRequirements.size;
+            if (remaining < bestRemaining)
+            {
+                bestBlock = block.get();
+                bestRangeOffset = freeRange.first;
+                bestOffset = offset;
+                bestRemaining = remaining;
+                if (remaining == 0)
+                    break;
+            }
+        }
+
+        if (bestRemaining == 0)
+            break;
+    }
+
+    if (!bestBlock)
+    {
+        bestBlock = createBlock(pool);
+        if (!bestBlock)
+            return allocation;
+    }
+
+    auto &freeRanges = bestBlock->freeRanges;
+
+    auto rangeIt = freeRanges.find(bestRangeOffset);
+    const auto rangeEnd = rangeIt->first + rangeIt->second;
+    freeRanges.erase(rangeIt);
+
+    if (bestOffset > bestRangeOffset)
+        freeRanges[bestRangeOffset] = bestOffset - bestRangeOffset;
+
+    const auto allocationEnd = bestOffset + memoryRequirements.size;
+    if (allocationEnd < rangeEnd)
+        freeRanges[allocationEnd] = rangeEnd - allocationEnd;
+
+    bestBlock->usedSize += memoryRequirements.size;
+    bestBlock->allocationCount += 1;
+
+    allocation.block = bestBlock;
+    allocation.deviceMemory = bestBlock->deviceMemory;
+    allocation.offset = bestOffset;
+    allocation.size = memoryRequirements.size;
+    return allocation;
+}
+void MemoryAllocator::release(Allocation &allocation)
+{
+    auto block = allocation.block;
+    if (!block)
+        return;
+
+    lock_guard<mutex> locker(m_mutex);
+
+    auto &freeRanges = block->freeRanges;
+
+    auto offset = allocation.offset;
+    auto size = allocation.size;
+
+    // Merge with adjacent free ranges
+    auto nextIt = freeRanges.lower_bound(offset);
+    if (nextIt != freeRanges.end() && offset + size == nextIt->first)
+    {
+        size += nextIt->second;
+        nextIt = freeRanges.erase(nextIt);
+    }
+    if (nextIt != freeRanges.begin())
+    {
+        auto prevIt = std::prev(nextIt);
+        if (prevIt->first + prevIt->second == offset)
+        {
+            offset = prevIt->first;
+            size += prevIt->second;
+            freeRanges.erase(prevIt);
+        }
+    }
+    freeRanges[offset] = size;
+
+    block->usedSize -= allocation.size;
+    block->allocationCount -= 1;
+
+    allocation = Allocation();
+
+    if (block->allocationCount > 0)
+        return;
+
+    // Keep at most one empty block per pool to avoid allocation churn
+    for (auto &&otherBlock : block->pool->blocks)
+    {
+        if (otherBlock.get() != block && otherBlock->allocationCount == 0)
+        {
+            destroyBlock(block);
+            break;
+        }
+    }
+}
+
+void *MemoryAllocator::map(const Allocation &allocation)
+{
+    auto block = allocation.block;
+    if (!block)
+        return nullptr;
+
+    lock_guard<mutex> locker(m_mutex);
+
+    if (block->mapCount == 0)
+        block->mapped = m_device.mapMemory(block->deviceMemory, 0, block->size, {}, m_device.dld());
+    block->mapCount += 1;
+
+    return reinterpret_cast<uint8_t *>(block->mapped) + allocation.offset;
+}
+void MemoryAllocator::unmap(const Allocation &allocation)
+{
+    auto block = allocation.block;
+    if (!block)
+        return;
+
+    lock_guard<mutex> locker(m_mutex);
+
+    if (block->mapCount == 0)
+        return;
+
+    block->mapCount -= 1;
+    if (block->mapCount == 0)
+    {
+        m_device.unmapMemory(block->deviceMemory, m_device.dld());
+        block->mapped = nullptr;
+    }
+}
+
+MemoryAllocator::Stats MemoryAllocator::stats() const
+{
+    Stats stats;
+
+    lock_guard<mutex> locker(m_mutex);
+
+    for (auto &&pool : m_pools)
+    {
+        for (auto &&block : pool.second->blocks)
+        {
+            stats.blocks += 1;
+            stats.allocations += block->allocationCount;
+            stats.allocatedSize += block->size;
+            stats.usedSize += block->usedSize;
+        }
+    }
+
+    return stats;
+}
+
+MemoryAllocator::Pool &MemoryAllocator::getPool(uint32_t memoryTypeIndex, bool linear, bool deviceAddress)
+{
+    // Linear and optimal resources never share a block, so "bufferImageGranularity" can be ignored
+    const uint32_t key = (memoryTypeIndex << 2) | (deviceAddress ? 2u : 0u) | (linear ? 1u : 0u);
+
+    auto &pool = m_pools[key];
+    if (!pool)
+    {
+        const auto physicalDevice = m_device.physicalDevice();
+        const auto memoryProperties = physicalDevice->getMemoryProperties(physicalDevice->dld());
+        const auto heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+
+        pool = make_unique<Pool>();
+        pool->memoryTypeIndex = memoryTypeIndex;
+        pool->deviceAddress = deviceAddress;
+        pool->blockSize = min(g_maxBlockSize, max(g_minBlockSize, heapSize / 16));
+    }
+    return *pool;
+}
+MemoryAllocator::Block *MemoryAllocator::createBlock(Pool &pool)
+{
+    vk::MemoryAllocateInfo allocateInfo;
+    allocateInfo.allocationSize = pool.blockSize;
+    allocateInfo.memoryTypeIndex = pool.memoryTypeIndex;
+
+    // Blocks of device address pools can be bound to buffers with a device address
+    vk::MemoryAllocateFlagsInfo memoryAllocateFlagsInfo(vk::MemoryAllocateFlagBits::eDeviceAddress);
+    if (pool.deviceAddress)
+        allocateInfo.pNext = &memoryAllocateFlagsInfo;
+
+    auto block = make_unique<Block>();
+    try
+    {
+        block->deviceMemory = m_device.allocateMemory(allocateInfo, m_device.allocationCallbacks(), m_device.dld());
+    }
+    catch (const vk::OutOfDeviceMemoryError &)
+    {
+        return nullptr;
+    }
+    block->pool = &pool;
+    block->size = pool.blockSize;
+    block->freeRanges[0] = block->size;
+
+    pool.blocks.push_back(move(block));
+    return pool.blocks.back().get();
+}
+void MemoryAllocator::destroyBlock(Block *block)
+{
+    auto &blocks = block->pool->blocks;
+
+    auto it = find_if(blocks.begin(), blocks.end(), [block](const unique_ptr<Block> &b) {
+        return (b.get() == block);
+    });
+    if (it == blocks.end())
+        return;
+
+    if (block->mapped)
+        m_device.unmapMemory(block->deviceMemory, m_device.dld());
+    m_device.freeMemory(block->deviceMemory, m_device.allocationCallbacks(), m_device.dld());
+
+    blocks.erase(it);
+}
+
+}
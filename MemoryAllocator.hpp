@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: MIT
+/*
+   QmVk - simple Vulkan library created for QMPlay2
+   Copyright (C) 2020-2025 Błażej Szczygieł
+*/
+
+#pragma once
+
+#include "QmVkExport.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+
+namespace QmVk {
+
+using namespace std;
+
+class Device;
+
+class QMVK_EXPORT MemoryAllocator
+{
+    struct Block;
+    struct Pool;
+
+public:
+    struct Allocation
+    {
+        Block *block = nullptr;
+        vk::DeviceMemory deviceMemory;
+        vk::DeviceSize offset = 0;
+        vk::DeviceSize size = 0;
+    };
+
+    struct Stats
+    {
+        uint32_t blocks = 0;
+        uint32_t allocations = 0;
+        vk::DeviceSize allocatedSize = 0;
+        vk::DeviceSize usedSize = 0;
+    };
+
+public:
+    MemoryAllocator(Device &device);
+    ~MemoryAllocator();
+
+public:
+    // Returns an empty allocation if the memory should be allocated separately
+    Allocation allocate(
+        uint32_t memoryTypeIndex,
+        const vk::MemoryRequirements &memoryRequirements,
+        bool linear,
+        bool deviceAddress = false
+    );
+    void release(Allocation &allocation);
+
+    void *map(const Allocation &allocation);
+    void unmap(const Allocation &allocation);
+
+    Stats stats() const;
+
+private:
+    Pool &getPool(uint32_t memoryTypeIndex, bool linear, bool deviceAddress);
+    Block *createBlock(Pool &pool);
+    void destroyBlock(Block *block);
+
+private:
+    Device &m_device;
+
+    mutable mutex m_mutex;
+    unordered_map<uint32_t, unique_ptr<Pool>> m_pools;
+};
+
+}
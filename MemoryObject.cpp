@@ -8,7 +8,8 @@
 #include "PhysicalDevice.hpp"
 #include "Device.hpp"
 #include "MemoryPropertyFlags.hpp"
-#include "CommandBuffer.hpp"
+#include "TransferBatch.hpp"
+#include "CommandBufferPool.hpp"
 
 namespace QmVk {
 
@@ -22,8 +23,19 @@ MemoryObject::MemoryObject(
 MemoryObject::~MemoryObject()
 {
     m_customData.reset();
-    for (auto &&deviceMemory : m_deviceMemory)
-        m_device->freeMemory(deviceMemory, nullptr, dld());
+
+    if (!m_allocation.block && m_deviceMemory.empty())
+        return;
+
+    m_device->deferRelease([device = m_device.get(), allocation = m_allocation, deviceMemory = move(m_deviceMemory)]() mutable {
+        if (allocation.block)
+        {
+            device->memoryAllocator()->release(allocation);
+            return;
+        }
+        for (auto &&memory : deviceMemory)
+            device->freeMemory(memory, device->allocationCallbacks(), device->dld());
+    });
 }
 
 void MemoryObject::importFD(
@@ -59,7 +71,7 @@ void MemoryObject::importFD(
             memoryTypeBits
         );
 
-        m_deviceMemory.push_back(m_device->allocateMemory(alloc, nullptr, dld()));
+        m_deviceMemory.push_back(m_device->allocateMemory(alloc, m_device->allocationCallbacks(), dld()));
     }
 }
 
@@ -90,14 +102,16 @@ void MemoryObject::importWin32Handle(
             ).memoryTypeBits
         );
 
-        m_deviceMemory.push_back(m_device->allocateMemory(alloc, nullptr, dld()));
+        m_deviceMemory.push_back(m_device->allocateMemory(alloc, m_device->allocationCallbacks(), dld()));
     }
 }
 #endif
 
 void MemoryObject::allocateMemory(
     const MemoryPropertyFlags &userMemoryPropertyFlags,
-    void *allocateInfoPNext)
+    bool linearResource,
+    void *allocateInfoPNext,
+    bool deviceAddress)
 {
     vk::ExportMemoryAllocateInfo exportMemoryAllocateInfo(m_exportMemoryTypes);
     if (m_exportMemoryTypes)
@@ -106,18 +120,49 @@ void MemoryObject::allocateMemory(
         allocateInfoPNext = &exportMemoryAllocateInfo;
     }
 
+#ifndef QMVK_NO_MEMORY_SUBALLOCATION
+    // Exported memory or memory with extra allocation info must be allocated separately
+    const bool suballocate = (allocateInfoPNext == nullptr);
+#else
+    const bool suballocate = false;
+#endif
+
     vk::MemoryAllocateInfo allocateInfo;
     allocateInfo.allocationSize = m_memoryRequirements.size;
     allocateInfo.pNext = allocateInfoPNext;
 
-    auto allocateMemoryInternal = [this, &allocateInfo](const MemoryPropertyFlags &userMemoryPropertyFlags) {
+    // Only for buffers with a device address
+    vk::MemoryAllocateFlagsInfo memoryAllocateFlagsInfo(vk::MemoryAllocateFlagBits::eDeviceAddress);
+    if (deviceAddress)
+    {
+        memoryAllocateFlagsInfo.pNext = allocateInfo.pNext;
+        allocateInfo.pNext = &memoryAllocateFlagsInfo;
+    }
+
+    auto allocateMemoryInternal = [&](const MemoryPropertyFlags &userMemoryPropertyFlags) {
         tie(allocateInfo.memoryTypeIndex, m_memoryPropertyFlags) = m_physicalDevice->findMemoryType(
             userMemoryPropertyFlags,
             m_memoryRequirements.memoryTypeBits,
             userMemoryPropertyFlags.heap
         );
 
-        m_deviceMemory.push_back(m_device->allocateMemory(allocateInfo, nullptr, dld()));
+        if (suballocate)
+        {
+            m_allocation = m_device->memoryAllocator()->allocate(
+                allocateInfo.memoryTypeIndex,
+                m_memoryRequirements,
+                linearResource,
+                deviceAddress
+            );
+            if (m_allocation.block)
+            {
+                m_deviceMemory.push_back(m_allocation.deviceMemory);
+                m_deviceMemoryOffset = m_allocation.offset;
+                return;
+            }
+        }
+
+        m_deviceMemory.push_back(m_device->allocateMemory(allocateInfo, m_device->allocationCallbacks(), dld()));
     };
 
     try
@@ -176,11 +221,40 @@ void MemoryObject::allocateMemory(
     }
 }
 
-shared_ptr<CommandBuffer> MemoryObject::internalCommandBuffer()
+void *MemoryObject::mapDeviceMemory()
+{
+    if (m_allocation.block)
+        return m_device->memoryAllocator()->map(m_allocation);
+
+    return m_device->mapMemory(deviceMemory(), m_deviceMemoryOffset, memorySize(), {}, dld());
+}
+void MemoryObject::unmapDeviceMemory()
+{
+    if (m_allocation.block)
+        m_device->memoryAllocator()->unmap(m_allocation);
+    else
+        m_device->unmapMemory(deviceMemory(), dld());
+}
+
+void MemoryObject::executeInternal(
+    const function<void(vk::CommandBuffer)> &callback,
+    const vector<shared_ptr<MemoryObjectBase>> &memoryObjects)
+{
+    if (auto transferBatch = m_device->transferBatch())
+    {
+        if (transferBatch->record(callback, memoryObjects))
+            return;
+
+        // Batched operations from another thread must be executed first
+        transferBatch->flush();
+    }
+    m_device->commandBufferPool()->execute(m_device->firstQueue(), callback);
+}
+void MemoryObject::flushTransferBatch()
 {
-    if (!m_internalCommandBuffer)
-        m_internalCommandBuffer = CommandBuffer::create(m_device->firstQueue());
-    return m_internalCommandBuffer;
+    // Host access must see the results of pending internal transfers
+    if (auto transferBatch = m_device->transferBatch())
+        transferBatch->flush();
 }
 
 int MemoryObject::exportMemoryFd(vk::ExternalMemoryHandleTypeFlagBits type)
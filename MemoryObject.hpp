@@ -9,6 +9,9 @@
 #include "QmVkExport.hpp"
 
 #include "MemoryObjectBase.hpp"
+#include "MemoryAllocator.hpp"
+
+#include <functional>
 
 namespace QmVk {
 
@@ -49,15 +52,25 @@ protected:
 
     void allocateMemory(
         const MemoryPropertyFlags &userMemoryPropertyFlags,
-        void *allocateInfoPNext = nullptr
+        bool linearResource,
+        void *allocateInfoPNext = nullptr,
+        bool deviceAddress = false
     );
 
+    void *mapDeviceMemory();
+    void unmapDeviceMemory();
+
 protected:
-    shared_ptr<CommandBuffer> internalCommandBuffer();
+    void executeInternal(
+        const function<void(vk::CommandBuffer)> &callback,
+        const vector<shared_ptr<MemoryObjectBase>> &memoryObjects
+    );
+    void flushTransferBatch();
 
 public:
     inline uint32_t deviceMemoryCount() const;
     inline vk::DeviceMemory deviceMemory(uint32_t idx = 0) const;
+    inline vk::DeviceSize deviceMemoryOffset(uint32_t idx = 0) const;
 
     inline vk::DeviceSize memorySize() const;
 
@@ -83,9 +96,10 @@ protected:
     vk::MemoryPropertyFlags m_memoryPropertyFlags;
 
     vector<vk::DeviceMemory> m_deviceMemory;
+    vk::DeviceSize m_deviceMemoryOffset = 0;
 
 private:
-    shared_ptr<CommandBuffer> m_internalCommandBuffer;
+    MemoryAllocator::Allocation m_allocation;
 };
 
 /* Inline implementation */
@@ -98,6 +112,10 @@ vk::DeviceMemory MemoryObject::deviceMemory(uint32_t idx) const
 {
     return m_deviceMemory[idx];
 }
+vk::DeviceSize MemoryObject::deviceMemoryOffset(uint32_t idx) const
+{
+    return (idx == 0) ? m_deviceMemoryOffset : 0;
+}
 
 vk::DeviceSize MemoryObject::memorySize() const
 {
@@ -7,6 +7,7 @@
 #include "MemoryObjectDescr.hpp"
 #include "Buffer.hpp"
 #include "BufferView.hpp"
+#include "BarrierBatch.hpp"
 #ifndef QMVK_NO_GRAPHICS
 #   include "Image.hpp"
 #   include "Sampler.hpp"
@@ -24,6 +25,35 @@ static vector<weak_ptr<MemoryObjectBase>> toMemoryObjectBaseVector(const vector<
     return objects;
 }
 
+static vk::AccessFlags2 getAccessFlags2(vk::DescriptorType descriptorType, vk::AccessFlags accessFlags)
+{
+    switch (descriptorType)
+    {
+        case vk::DescriptorType::eUniformBuffer:
+        case vk::DescriptorType::eUniformBufferDynamic:
+            return vk::AccessFlagBits2::eUniformRead;
+        case vk::DescriptorType::eCombinedImageSampler:
+        case vk::DescriptorType::eSampledImage:
+        case vk::DescriptorType::eUniformTexelBuffer:
+            return vk::AccessFlagBits2::eShaderSampledRead;
+        case vk::DescriptorType::eStorageBuffer:
+        case vk::DescriptorType::eStorageBufferDynamic:
+        case vk::DescriptorType::eStorageImage:
+        case vk::DescriptorType::eStorageTexelBuffer:
+        {
+            vk::AccessFlags2 accessFlags2;
+            if (accessFlags & vk::AccessFlagBits::eShaderRead)
+                accessFlags2 |= vk::AccessFlagBits2::eShaderStorageRead;
+            if (accessFlags & vk::AccessFlagBits::eShaderWrite)
+                accessFlags2 |= vk::AccessFlagBits2::eShaderStorageWrite;
+            return accessFlags2;
+        }
+        default:
+            break;
+    }
+    return BarrierBatch::toAccess2(accessFlags);
+}
+
 MemoryObjectDescr::MemoryObjectDescr(
     const vector<shared_ptr<Buffer>> &buffers,
     Access access,
@@ -107,7 +137,7 @@ MemoryObjectDescr::MemoryObjectDescr(
 {}
 
 void MemoryObjectDescr::prepareObject(
-    vk::CommandBuffer commandBuffer,
+    BarrierBatch &barrierBatch,
     vk::PipelineStageFlags pipelineStageFlags) const
 {
     vk::AccessFlags accessFlag = {};
@@ -126,6 +156,9 @@ void MemoryObjectDescr::prepareObject(
             break;
     }
 
+    const auto stageFlags2 = BarrierBatch::toStage2(pipelineStageFlags);
+    const auto accessFlags2 = getAccessFlags2(descriptorType().type, accessFlag);
+
 #ifndef QMVK_NO_GRAPHICS
     size_t descriptorInfosIdx = 0;
 #endif
@@ -144,9 +177,11 @@ void MemoryObjectDescr::prepareObject(
                     : static_pointer_cast<Buffer>(object)
                 ;
                 buffer->pipelineBarrier(
-                    commandBuffer,
+                    barrierBatch,
                     pipelineStageFlags,
-                    accessFlag
+                    accessFlag,
+                    stageFlags2,
+                    accessFlags2
                 );
                 break;
             }
@@ -155,10 +190,13 @@ void MemoryObjectDescr::prepareObject(
 #ifndef QMVK_NO_GRAPHICS
                 auto image = static_pointer_cast<Image>(object);
                 image->pipelineBarrier(
-                    commandBuffer,
+                    barrierBatch,
                     descriptorInfos()[descriptorInfosIdx].descrImgInfo.imageLayout,
                     pipelineStageFlags,
-                    accessFlag
+                    accessFlag,
+                    stageFlags2,
+                    accessFlags2,
+                    m_plane
                 );
                 descriptorInfosIdx += (m_plane == ~0u && !image->samplerYcbcr())
                     ? image->numPlanes()
@@ -171,7 +209,7 @@ void MemoryObjectDescr::prepareObject(
     }
 }
 void MemoryObjectDescr::finalizeObject(
-    vk::CommandBuffer commandBuffer,
+    BarrierBatch &barrierBatch,
     bool genMipmapsOnWrite,
     bool resetPipelineStageFlags) const
 {
@@ -195,7 +233,7 @@ void MemoryObjectDescr::finalizeObject(
                         : static_pointer_cast<Buffer>(object)
                     ;
                     buffer->pipelineBarrier(
-                        commandBuffer,
+                        barrierBatch,
                         vk::PipelineStageFlagBits::eBottomOfPipe,
                         vk::AccessFlags()
                     );
@@ -208,16 +246,13 @@ void MemoryObjectDescr::finalizeObject(
                 auto image = static_pointer_cast<Image>(object);
                 if (genMipmapsOnWrite && m_access == Access::Write)
                 {
-                    image->maybeGenerateMipmaps(commandBuffer);
+                    // Mipmap generation records its own commands
+                    barrierBatch.flush();
+                    image->maybeGenerateMipmaps(barrierBatch.commandBuffer());
                 }
                 if (resetPipelineStageFlags)
                 {
-                    image->pipelineBarrier(
-                        commandBuffer,
-                        image->imageLayout(),
-                        vk::PipelineStageFlagBits::eBottomOfPipe,
-                        vk::AccessFlags()
-                    );
+                    image->resetPipelineStage(barrierBatch);
                 }
 #endif
                 break;
@@ -18,6 +18,7 @@ using namespace std;
 
 class Buffer;
 class BufferView;
+class BarrierBatch;
 #ifndef QMVK_NO_GRAPHICS
 class Image;
 class Sampler;
@@ -98,11 +99,11 @@ public:
 
 private:
     void prepareObject(
-        vk::CommandBuffer commandBuffer,
+        BarrierBatch &barrierBatch,
         vk::PipelineStageFlags pipelineStageFlags
     ) const;
     void finalizeObject(
-        vk::CommandBuffer commandBuffer,
+        BarrierBatch &barrierBatch,
         bool genMipmapsOnWrite,
         bool resetPipelineStageFlags
     ) const;
@@ -39,11 +39,16 @@ vector<DescriptorType> MemoryObjectDescrs::fetchDescriptorTypes() const
 }
 vector<DescriptorInfo> MemoryObjectDescrs::fetchDescriptorInfos() const
 {
+    size_t count = 0;
+    for (auto &&memoryObjectDescr : *m_memoryObjects)
+        count += memoryObjectDescr.descriptorInfos().size();
+
     vector<DescriptorInfo> descriptorInfos;
+    descriptorInfos.reserve(count);
     for (auto &&memoryObjectDescr : *m_memoryObjects)
     {
-        for (auto &&descriptorInfo : memoryObjectDescr.descriptorInfos())
-            descriptorInfos.push_back(descriptorInfo);
+        const auto &memoryObjectDescriptorInfos = memoryObjectDescr.descriptorInfos();
+        descriptorInfos.insert(descriptorInfos.end(), memoryObjectDescriptorInfos.begin(), memoryObjectDescriptorInfos.end());
     }
     return descriptorInfos;
 }
@@ -62,7 +67,7 @@ void MemoryObjectDescrs::iterateMemoryObjects(const Callback &callback) const
 }
 
 void MemoryObjectDescrs::prepareObjects(
-    vk::CommandBuffer commandBuffer,
+    BarrierBatch &barrierBatch,
     vk::PipelineStageFlags pipelineStageFlags) const
 {
 #ifndef NDEBUG
@@ -87,15 +92,15 @@ void MemoryObjectDescrs::prepareObjects(
     }
 #endif
     for (auto &&memoryObjectDescr : *m_memoryObjects)
-        memoryObjectDescr.prepareObject(commandBuffer, pipelineStageFlags);
+        memoryObjectDescr.prepareObject(barrierBatch, pipelineStageFlags);
 }
 void MemoryObjectDescrs::finalizeObjects(
-    vk::CommandBuffer commandBuffer,
+    BarrierBatch &barrierBatch,
     bool genMipmapsOnWrite,
     bool resetPipelineStageFlags) const
 {
     for (auto &&memoryObjectDescr : *m_memoryObjects)
-        memoryObjectDescr.finalizeObject(commandBuffer, genMipmapsOnWrite, resetPipelineStageFlags);
+        memoryObjectDescr.finalizeObject(barrierBatch, genMipmapsOnWrite, resetPipelineStageFlags);
 }
 
 bool MemoryObjectDescrs::operator ==(const MemoryObjectDescrs &other) const
@@ -39,11 +39,11 @@ public:
 
 private:
     void prepareObjects(
-        vk::CommandBuffer commandBuffer,
+        BarrierBatch &barrierBatch,
         vk::PipelineStageFlags pipelineStageFlags
     ) const;
     void finalizeObjects(
-        vk::CommandBuffer commandBuffer,
+        BarrierBatch &barrierBatch,
         bool genMipmapsOnWrite,
         bool resetPipelineStageFlags
     ) const;
@@ -49,22 +49,34 @@ void PhysicalDevice::init()
     {
         if (useGetProperties2KHR)
         {
-            tie(m_properties, m_pciBusInfo) = getProperties2KHR<
+            tie(m_properties, m_pciBusInfo, m_pushDescriptorProperties, m_descriptorIndexingProperties, m_descriptorBufferProperties) = getProperties2KHR<
                 decltype(m_properties),
-                decltype(m_pciBusInfo)
+                decltype(m_pciBusInfo),
+                decltype(m_pushDescriptorProperties),
+                decltype(m_descriptorIndexingProperties),
+                decltype(m_descriptorBufferProperties)
             >(dld()).get<
                 decltype(m_properties),
-                decltype(m_pciBusInfo)
+                decltype(m_pciBusInfo),
+                decltype(m_pushDescriptorProperties),
+                decltype(m_descriptorIndexingProperties),
+                decltype(m_descriptorBufferProperties)
             >();
         }
         else
         {
-            tie(m_properties, m_pciBusInfo) = getProperties2<
+            tie(m_properties, m_pciBusInfo, m_pushDescriptorProperties, m_descriptorIndexingProperties, m_descriptorBufferProperties) = getProperties2<
                 decltype(m_properties),
-                decltype(m_pciBusInfo)
+                decltype(m_pciBusInfo),
+                decltype(m_pushDescriptorProperties),
+                decltype(m_descriptorIndexingProperties),
+                decltype(m_descriptorBufferProperties)
             >(dld()).get<
                 decltype(m_properties),
-                decltype(m_pciBusInfo)
+                decltype(m_pciBusInfo),
+                decltype(m_pushDescriptorProperties),
+                decltype(m_descriptorIndexingProperties),
+                decltype(m_descriptorBufferProperties)
             >();
         }
 
@@ -174,12 +186,13 @@ bool PhysicalDevice::checkExtensions(
 shared_ptr<Device> PhysicalDevice::createDevice(
     const vk::PhysicalDeviceFeatures2 &features,
     const vector<const char *> &extensions,
-    const vector<pair<uint32_t, uint32_t>> &queuesFamily)
+    const vector<pair<uint32_t, uint32_t>> &queuesFamily,
+    const shared_ptr<HostAllocator> &hostAllocator)
 {
     auto device = make_shared<Device>(
         shared_from_this()
     );
-    device->init(features, extensions, queuesFamily);
+    device->init(features, extensions, queuesFamily, hostAllocator);
     return device;
 }
 
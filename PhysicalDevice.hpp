@@ -23,6 +23,7 @@ using namespace std;
 class MemoryPropertyFlags;
 class AbstractInstance;
 class Device;
+class HostAllocator;
 
 class QMVK_EXPORT PhysicalDevice : public vk::PhysicalDevice, public enable_shared_from_this<PhysicalDevice>
 {
@@ -75,6 +76,10 @@ public:
 
     inline bool hasFullHostVisibleDeviceLocal() const;
 
+    inline uint32_t maxPushDescriptors() const;
+    inline const auto &descriptorIndexingProperties() const;
+    inline const auto &descriptorBufferProperties() const;
+
     inline vk::Extent2D localWorkgroupSize() const;
 
     inline bool isGpu() const;
@@ -92,7 +97,8 @@ public:
     shared_ptr<Device> createDevice(
         const vk::PhysicalDeviceFeatures2 &features,
         const vector<const char *> &extensions,
-        const vector<pair<uint32_t, uint32_t>> &queuesFamily
+        const vector<pair<uint32_t, uint32_t>> &queuesFamily,
+        const shared_ptr<HostAllocator> &hostAllocator = nullptr
     );
 
     inline shared_ptr<AbstractInstance> instance() const;
@@ -135,6 +141,9 @@ private:
 
     vk::PhysicalDeviceProperties2 m_properties;
     vk::PhysicalDevicePCIBusInfoPropertiesEXT m_pciBusInfo;
+    vk::PhysicalDevicePushDescriptorPropertiesKHR m_pushDescriptorProperties;
+    vk::PhysicalDeviceDescriptorIndexingProperties m_descriptorIndexingProperties;
+    vk::PhysicalDeviceDescriptorBufferPropertiesEXT m_descriptorBufferProperties;
 
     bool m_hasMemoryBudget = false;
     bool m_hasPciBusInfo = false;
@@ -197,6 +206,19 @@ bool PhysicalDevice::hasFullHostVisibleDeviceLocal() const
     return m_hasFullHostVisibleDeviceLocal;
 }
 
+uint32_t PhysicalDevice::maxPushDescriptors() const
+{
+    return m_pushDescriptorProperties.maxPushDescriptors;
+}
+const auto &PhysicalDevice::descriptorIndexingProperties() const
+{
+    return m_descriptorIndexingProperties;
+}
+const auto &PhysicalDevice::descriptorBufferProperties() const
+{
+    return m_descriptorBufferProperties;
+}
+
 vk::Extent2D PhysicalDevice::localWorkgroupSize() const
 {
     return m_localWorkgroupSize;
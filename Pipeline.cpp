@@ -7,13 +7,24 @@
 #include "Pipeline.hpp"
 #include "PhysicalDevice.hpp"
 #include "Device.hpp"
+#include "DescriptorSetLayout.hpp"
+#include "LayoutCache.hpp"
+#include "BindlessTable.hpp"
 #include "DescriptorPool.hpp"
+#include "DescriptorAllocator.hpp"
 #include "DescriptorSet.hpp"
 #include "DescriptorInfo.hpp"
 #include "CommandBuffer.hpp"
+#include "Queue.hpp"
+#include "BarrierBatch.hpp"
+#include "MemoryPropertyFlags.hpp"
+#include "Buffer.hpp"
+#include "PipelineCache.hpp"
 
 namespace QmVk {
 
+constexpr uint32_t g_maxDescriptorSetsRingGrowth = 4;
+
 Pipeline::Pipeline(
     const shared_ptr<Device> &device,
     const vk::ShaderStageFlags pushConstantsShaderStageFlags,
@@ -26,7 +37,67 @@ Pipeline::Pipeline(
     , m_pushConstants(pushConstantsSize)
 {}
 Pipeline::~Pipeline()
-{}
+{
+    if (m_pendingProgram.valid())
+        m_pendingProgram.wait();
+    releasePipelineVariants(0);
+}
+
+bool Pipeline::canUseShaderObjects() const
+{
+    return m_device->hasShaderObject();
+}
+void Pipeline::appendVariantData(vector<uint32_t> &variantData)
+{
+    (void)variantData;
+}
+
+void Pipeline::prepareCreationFeedback(
+    Program &program,
+    vk::PipelineCreationFeedbackCreateInfo &creationFeedbackCreateInfo,
+    const void *&pNext) const
+{
+    if (!m_device->hasPipelineCreationFeedback())
+        return;
+
+    program.stageCreationFeedbacks.resize(program.shaderStages.size());
+
+    creationFeedbackCreateInfo.pPipelineCreationFeedback = &program.creationFeedback;
+    creationFeedbackCreateInfo.pipelineStageCreationFeedbackCount = program.stageCreationFeedbacks.size();
+    creationFeedbackCreateInfo.pPipelineStageCreationFeedbacks = program.stageCreationFeedbacks.data();
+    creationFeedbackCreateInfo.pNext = pNext;
+    pNext = &creationFeedbackCreateInfo;
+}
+void Pipeline::addCreationFeedback(const Program &program) const
+{
+    m_device->pipelineCache()->addFeedback(program.creationFeedback, program.stageCreationFeedbacks);
+}
+
+Pipeline::Program Pipeline::createShaderObjects(
+    vector<vk::ShaderCreateInfoEXT> &shaderCreateInfos,
+    const vector<vk::DescriptorSetLayout> &setLayouts) const
+{
+    vk::PushConstantRange pushConstantRange;
+    pushConstantRange.stageFlags = m_pushConstantsShaderStageFlags;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = m_pushConstants.size();
+
+    Program program;
+    for (auto &&shaderCreateInfo : shaderCreateInfos)
+    {
+        // Must match the pipeline layout used for binding
+        shaderCreateInfo.setLayoutCount = setLayouts.size();
+        shaderCreateInfo.pSetLayouts = setLayouts.data();
+        if (pushConstantRange.size > 0)
+        {
+            shaderCreateInfo.pushConstantRangeCount = 1;
+            shaderCreateInfo.pPushConstantRanges = &pushConstantRange;
+        }
+        program.shaderStages.push_back(shaderCreateInfo.stage);
+    }
+    program.shaders = m_device->createShadersEXTUnique(shaderCreateInfos, m_device->allocationCallbacks(), m_dld).value;
+    return program;
+}
 
 void Pipeline::setCustomSpecializationData(
     const vector<uint32_t> &data,
@@ -41,6 +112,7 @@ void Pipeline::setCustomSpecializationData(
 }
 
 vk::SpecializationInfo Pipeline::getSpecializationInfo(
+    const Variant &variant,
     vk::ShaderStageFlagBits shaderStageFlag,
     vector<vk::SpecializationMapEntry> &specializationMapEntries,
     vector<uint32_t> &specializationData) const
@@ -51,8 +123,8 @@ vk::SpecializationInfo Pipeline::getSpecializationInfo(
     for (uint32_t i = 0; i < initialCount; ++i)
         specializationMapEntries.emplace_back(i, i * constantSize, constantSize);
 
-    auto customSpecializationDataIt = m_customSpecializationData.find(shaderStageFlag);
-    if (customSpecializationDataIt != m_customSpecializationData.end())
+    auto customSpecializationDataIt = variant.customSpecializationData.find(shaderStageFlag);
+    if (customSpecializationDataIt != variant.customSpecializationData.end())
     {
         for (uint32_t i = 0; i < customSpecializationDataIt->second.size(); ++i)
         {
@@ -89,9 +161,40 @@ void Pipeline::bindObjects(
     const shared_ptr<CommandBuffer> &commandBuffer,
     vk::PipelineBindPoint pipelineBindPoint)
 {
-    commandBuffer->bindPipeline(pipelineBindPoint, *m_pipeline, m_dld);
-    if (m_descriptorSet)
+    if (!m_shaders.empty())
+        commandBuffer->bindShadersEXT(m_shaderStages, m_shaders, m_dld);
+    else
+        commandBuffer->bindPipeline(pipelineBindPoint, m_pipeline, m_dld);
+    if (m_descriptorSetLayout->isPushDescriptors())
+    {
+        commandBuffer->storeData(m_memoryObjects);
+        pushDescriptors(commandBuffer, pipelineBindPoint);
+    }
+    else if (m_descriptorSetLayout->isDescriptorBuffer())
+    {
+        commandBuffer->storeData(m_memoryObjects);
+        commandBuffer->storeData(m_descriptorBuffer);
+
+        vk::DescriptorBufferBindingInfoEXT descriptorBufferBindingInfo;
+        descriptorBufferBindingInfo.address = m_descriptorBuffer->deviceAddress();
+        descriptorBufferBindingInfo.usage = m_descriptorBuffer->usage();
+        commandBuffer->bindDescriptorBuffersEXT(descriptorBufferBindingInfo, m_dld);
+
+        const uint32_t bufferIndex = 0;
+        const vk::DeviceSize offset = 0;
+        commandBuffer->setDescriptorBufferOffsetsEXT(
+            pipelineBindPoint,
+            *m_pipelineLayout,
+            0,
+            bufferIndex,
+            offset,
+            m_dld
+        );
+    }
+    else if (m_descriptorSet)
     {
+        if (!m_descriptorSetsRing.empty())
+            m_descriptorSetsQueue = commandBuffer->queue();
         commandBuffer->storeData(
             m_memoryObjects,
             m_descriptorSet
@@ -105,10 +208,111 @@ void Pipeline::bindObjects(
             m_dld
         );
     }
+    if (m_bindlessTable)
+    {
+        commandBuffer->bindDescriptorSets(
+            pipelineBindPoint,
+            *m_pipelineLayout,
+            1,
+            {m_bindlessTable->descriptorSet()},
+            {},
+            m_dld
+        );
+    }
+}
+
+void Pipeline::pushDescriptors(
+    const shared_ptr<CommandBuffer> &commandBuffer,
+    vk::PipelineBindPoint pipelineBindPoint)
+{
+    if (!m_pushDescriptorUpdateTemplate)
+        m_pushDescriptorUpdateTemplate = m_descriptorSetLayout->createPushDescriptorUpdateTemplate(pipelineBindPoint, *m_pipelineLayout);
+
+    if (m_pushDescriptorUpdateTemplate)
+    {
+        commandBuffer->pushDescriptorSetWithTemplateKHR(
+            *m_pushDescriptorUpdateTemplate,
+            *m_pipelineLayout,
+            0,
+            m_pushDescriptorInfos.data(),
+            m_dld
+        );
+    }
+    else
+    {
+        commandBuffer->pushDescriptorSetKHR(
+            pipelineBindPoint,
+            *m_pipelineLayout,
+            0,
+            m_descriptorSetLayout->getWriteDescriptorSets(m_pushDescriptorInfos),
+            m_dld
+        );
+    }
+}
+
+void Pipeline::setMaxVariants(uint32_t maxVariants)
+{
+    m_maxVariants = max(maxVariants, 1u);
+    releasePipelineVariants(m_maxVariants);
+}
+
+void Pipeline::setPushDescriptors(bool pushDescriptors)
+{
+    if (m_pushDescriptors == pushDescriptors)
+        return;
+
+    m_pushDescriptors = pushDescriptors;
+    m_descriptorSet.reset();
+}
+bool Pipeline::usesPushDescriptors() const
+{
+    return (m_descriptorSetLayout && m_descriptorSetLayout->isPushDescriptors());
+}
+
+void Pipeline::setDescriptorSetsRingSize(uint32_t size)
+{
+    size = max(size, 1u);
+    if (m_descriptorSetsRingSize == size)
+        return;
+
+    m_descriptorSetsRingSize = size;
+    if (!m_descriptorSetsRing.empty())
+    {
+        m_descriptorSetsRing.clear();
+        m_descriptorSet.reset();
+    }
+}
+
+void Pipeline::setShaderObjects(bool shaderObjects)
+{
+    if (m_shaderObjects == shaderObjects)
+        return;
+
+    m_shaderObjects = shaderObjects;
+    m_mustRecreate = true;
+}
+bool Pipeline::usesShaderObjects() const
+{
+    return (m_shaderObjects && canUseShaderObjects());
+}
+
+bool Pipeline::usesDescriptorBuffer() const
+{
+    return (m_descriptorSetLayout && m_descriptorSetLayout->isDescriptorBuffer());
+}
+
+void Pipeline::setBindlessTable(const shared_ptr<BindlessTable> &bindlessTable)
+{
+    if (m_bindlessTable == bindlessTable)
+        return;
+
+    m_bindlessTable = bindlessTable;
+    m_mustRecreateLayout = true;
 }
 
 void Pipeline::createDescriptorSetFromPool(const shared_ptr<DescriptorPool> &descriptorPool)
 {
+    m_descriptorSetsRing.clear();
     m_descriptorSet.reset();
     if (descriptorPool)
     {
@@ -126,13 +330,199 @@ void Pipeline::setMemoryObjects(const MemoryObjectDescrs &memoryObjects)
 }
 
 void Pipeline::prepare()
+{
+    prepareLayout();
+
+    if (m_mustRecreate)
+    {
+        finishPendingVariant(true);
+
+        auto variant = getVariant();
+        if (!usePipelineVariant(variant))
+        {
+            auto program = createProgram(variant, *m_pipelineLayout, m_setLayouts);
+            bindProgram(addPipelineVariant(move(variant), move(program)));
+        }
+
+        m_mustRecreate = false;
+    }
+}
+bool Pipeline::prepareAsync()
+{
+    prepareLayout();
+
+    if (!m_mustRecreate)
+        return true;
+
+    finishPendingVariant(false);
+
+    auto variant = getVariant();
+    if (usePipelineVariant(variant))
+    {
+        m_mustRecreate = false;
+        return true;
+    }
+
+    // Only one variant is compiled at once, another one is started on a next call
+    if (!m_pendingProgram.valid())
+    {
+        m_pendingProgram = m_device->workerPool()->submit([this, variant, pipelineLayout = *m_pipelineLayout, setLayouts = m_setLayouts] {
+            return createProgram(variant, pipelineLayout, setLayouts);
+        });
+        m_pendingVariant = move(variant);
+    }
+
+    return false;
+}
+
+bool Pipeline::canUseDescriptorBuffer(const vector<DescriptorType> &descriptorTypes) const
+{
+    // All descriptor sets of a pipeline must use descriptor buffers
+    if (descriptorTypes.empty() || m_bindlessTable || !m_device->hasDescriptorBuffer())
+        return false;
+
+    for (auto &&descriptorType : descriptorTypes)
+    {
+        switch (descriptorType.type)
+        {
+            case vk::DescriptorType::eUniformBuffer:
+            case vk::DescriptorType::eStorageBuffer:
+            case vk::DescriptorType::eCombinedImageSampler:
+            case vk::DescriptorType::eSampledImage:
+            case vk::DescriptorType::eStorageImage:
+                break;
+            default:
+                return false;
+        }
+#ifndef QMVK_NO_GRAPHICS
+        // Would require embedded immutable samplers
+        if (!descriptorType.immutableSamplers.empty())
+            return false;
+#endif
+    }
+    return true;
+}
+shared_ptr<Buffer> Pipeline::acquireDescriptorBuffer()
+{
+    const auto size = m_descriptorSetLayout->descriptorBufferSize();
+
+    for (size_t i = 1; i <= m_descriptorBuffers.size(); ++i)
+    {
+        const size_t idx = (m_descriptorBuffersIdx + i) % m_descriptorBuffers.size();
+
+        // Descriptor buffers used by command buffers are referenced by their stored data
+        if (m_descriptorBuffers[idx].use_count() == 1 && m_descriptorBuffers[idx]->size() >= size)
+        {
+            m_descriptorBuffersIdx = idx;
+            return m_descriptorBuffers[idx];
+        }
+    }
+
+    vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eResourceDescriptorBufferEXT | vk::BufferUsageFlagBits::eShaderDeviceAddress;
+    for (auto &&descriptorType : m_descriptorSetLayout->descriptorTypes())
+    {
+        if (descriptorType.type == vk::DescriptorType::eCombinedImageSampler)
+        {
+            usage |= vk::BufferUsageFlagBits::eSamplerDescriptorBufferEXT;
+            break;
+        }
+    }
+
+    MemoryPropertyFlags memoryPropertyFlags;
+    memoryPropertyFlags.required = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+    memoryPropertyFlags.optional = vk::MemoryPropertyFlagBits::eDeviceLocal;
+
+    // All descriptor buffers are in use, create another one
+    m_descriptorBuffersIdx = m_descriptorBuffers.size();
+    m_descriptorBuffers.push_back(Buffer::create(m_device, size, usage, memoryPropertyFlags));
+    return m_descriptorBuffers[m_descriptorBuffersIdx];
+}
+
+shared_ptr<DescriptorSet> Pipeline::acquireDescriptorSet()
+{
+    if (!m_descriptorSetsRing.empty() && m_descriptorSetsRing[0]->descriptorSetLayout() != m_descriptorSetLayout)
+        m_descriptorSetsRing.clear();
+
+    auto findUnusedDescriptorSet = [this] {
+        for (size_t i = 1; i <= m_descriptorSetsRing.size(); ++i)
+        {
+            const size_t idx = (m_descriptorSetsRingIdx + i) % m_descriptorSetsRing.size();
+
+            // Descriptor sets used by command buffers are referenced by their stored data
+            if (m_descriptorSetsRing[idx].use_count() == 1)
+            {
+                m_descriptorSetsRingIdx = idx;
+                return true;
+            }
+        }
+        return false;
+    };
+
+    if (findUnusedDescriptorSet())
+        return m_descriptorSetsRing[m_descriptorSetsRingIdx];
+
+    // Finished submissions release their stored data
+    auto queue = m_descriptorSetsQueue.lock();
+    if (queue)
+    {
+        queue->collectCompletions();
+        if (findUnusedDescriptorSet())
+            return m_descriptorSetsRing[m_descriptorSetsRingIdx];
+    }
+
+    if (m_descriptorSetsRing.size() >= static_cast<size_t>(m_descriptorSetsRingSize) * g_maxDescriptorSetsRingGrowth)
+    {
+        // The ring can't grow anymore, wait for the submitted commands
+        if (queue)
+        {
+            queue->waitForCommandsFinished();
+            queue->collectCompletions();
+            if (findUnusedDescriptorSet())
+                return m_descriptorSetsRing[m_descriptorSetsRingIdx];
+        }
+        throw vk::LogicError("All descriptor sets are used by command buffers which aren't submitted");
+    }
+
+    // All descriptor sets are in use, allocate more
+    auto descriptorSets = m_device->descriptorAllocator()->allocate(
+        m_descriptorSetLayout,
+        m_descriptorSetsRingSize
+    );
+    m_descriptorSetsRingIdx = m_descriptorSetsRing.size();
+    m_descriptorSetsRing.insert(m_descriptorSetsRing.end(), descriptorSets.begin(), descriptorSets.end());
+    return m_descriptorSetsRing[m_descriptorSetsRingIdx];
+}
+
+bool Pipeline::canUsePushDescriptors(const vector<DescriptorType> &descriptorTypes) const
+{
+    if (!m_pushDescriptors || descriptorTypes.empty() || !m_device->hasPushDescriptors())
+        return false;
+
+    uint32_t count = 0;
+    for (auto &&descriptorType : descriptorTypes)
+    {
+        switch (descriptorType.type)
+        {
+            case vk::DescriptorType::eUniformBufferDynamic:
+            case vk::DescriptorType::eStorageBufferDynamic:
+                // Not allowed in push descriptor set layouts
+                return false;
+            default:
+                break;
+        }
+        count += descriptorType.descriptorCount;
+    }
+    return (count <= m_device->physicalDevice()->maxPushDescriptors());
+}
+
+void Pipeline::prepareLayout()
 {
     const auto descriptorTypes = m_memoryObjects.fetchDescriptorTypes();
     bool descriptorSetLayoutFromDescriptorSet = false;
 
     if (m_descriptorSet)
     {
-        auto descriptorSetLayout = m_descriptorSet->descriptorPool()->descriptorSetLayout();
+        auto descriptorSetLayout = m_descriptorSet->descriptorSetLayout();
         descriptorSetLayoutFromDescriptorSet = (descriptorSetLayout == m_descriptorSetLayout);
         if (descriptorSetLayout->descriptorTypes() != descriptorTypes)
         {
@@ -142,28 +532,70 @@ void Pipeline::prepare()
         }
     }
 
+    auto mode = DescriptorSetLayout::Mode::DescriptorSet;
+    if (!m_descriptorSet)
+    {
+        if (canUsePushDescriptors(descriptorTypes))
+            mode = DescriptorSetLayout::Mode::PushDescriptors;
+        else if (canUseDescriptorBuffer(descriptorTypes))
+            mode = DescriptorSetLayout::Mode::DescriptorBuffer;
+    }
+
     if (!descriptorSetLayoutFromDescriptorSet)
     {
-        if (m_descriptorSetLayout && m_descriptorSetLayout->descriptorTypes() != descriptorTypes)
+        if (m_descriptorSetLayout && (m_descriptorSetLayout->descriptorTypes() != descriptorTypes || m_descriptorSetLayout->mode() != mode))
             m_descriptorSetLayout.reset();
     }
 
     if (!m_descriptorSetLayout)
     {
         m_descriptorSetLayout = m_descriptorSet
-            ? m_descriptorSet->descriptorPool()->descriptorSetLayout()
-            : DescriptorSetLayout::create(m_device, descriptorTypes)
+            ? m_descriptorSet->descriptorSetLayout()
+            : m_device->layoutCache()->descriptorSetLayout(descriptorTypes, mode)
         ;
-        m_mustRecreate = true;
+        m_descriptorBuffer.reset();
+        m_mustRecreateLayout = true;
+        m_mustUpdateDescriptorInfos = true;
+    }
+
+    if (m_descriptorSetLayout->isPushDescriptors())
+    {
+        // Descriptors are pushed when binding, so no descriptor set needs to be updated
+        if (m_mustUpdateDescriptorInfos)
+        {
+            m_mustUpdateDescriptorInfos = false;
+            m_pushDescriptorInfos = m_memoryObjects.fetchDescriptorInfos();
+        }
     }
+    else if (m_descriptorSetLayout->isDescriptorBuffer())
+    {
+        if (m_mustUpdateDescriptorInfos)
+        {
+            m_mustUpdateDescriptorInfos = false;
 
-    if (!m_descriptorSetLayout->isEmpty())
+            // The current descriptor buffer can still be used by the GPU
+            m_descriptorBuffer = acquireDescriptorBuffer();
+            m_descriptorSetLayout->writeDescriptorBuffer(
+                m_descriptorBuffer->map(),
+                m_memoryObjects.fetchDescriptorInfos()
+            );
+        }
+    }
+    else if (!m_descriptorSetLayout->isEmpty())
     {
         if (!m_descriptorSet)
         {
-            m_descriptorSet = DescriptorSet::create(DescriptorPool::create(m_descriptorSetLayout));
+            m_descriptorSet = (m_descriptorSetsRingSize > 1)
+                ? acquireDescriptorSet()
+                : m_device->descriptorAllocator()->allocate(m_descriptorSetLayout)
+            ;
             m_mustUpdateDescriptorInfos = true;
         }
+        else if (m_mustUpdateDescriptorInfos && !m_descriptorSetsRing.empty())
+        {
+            // The current descriptor set can still be used by the GPU
+            m_descriptorSet = acquireDescriptorSet();
+        }
         if (m_mustUpdateDescriptorInfos)
         {
             m_mustUpdateDescriptorInfos = false;
@@ -171,32 +603,213 @@ void Pipeline::prepare()
         }
     }
 
-    if (m_mustRecreate)
+    if (m_mustRecreateLayout)
     {
-        vk::PushConstantRange pushConstantRange;
-        pushConstantRange.stageFlags = m_pushConstantsShaderStageFlags;
-        pushConstantRange.offset = 0;
-        pushConstantRange.size = m_pushConstants.size();
+        createPipelineLayout();
+        m_mustRecreateLayout = false;
+        m_mustRecreate = true;
+    }
+}
 
-        const auto maxPushConstantsSize = m_device->physicalDevice()->limits().maxPushConstantsSize;
-        if (m_pushConstants.size() > m_device->physicalDevice()->limits().maxPushConstantsSize)
-            throw vk::LogicError("Push constants size exceeded: " + to_string(m_pushConstants.size()) + " > " + to_string(maxPushConstantsSize));
+void Pipeline::createPipelineLayout()
+{
+    // Pipelines created with the previous layout are incompatible
+    finishPendingVariant(true);
+    releasePipelineVariants(0);
+    unbindProgram();
 
-        vk::PipelineLayoutCreateInfo pipelineLayoutInfo;
-        if (!m_descriptorSetLayout->isEmpty())
-        {
-            pipelineLayoutInfo.setLayoutCount = 1;
-            pipelineLayoutInfo.pSetLayouts = *m_descriptorSetLayout;
-        }
-        if (pushConstantRange.size > 0)
+    m_pushDescriptorUpdateTemplate.reset();
+    if (!m_descriptorSetLayout->isPushDescriptors())
+        m_pushDescriptorInfos.clear();
+    if (!m_descriptorSetLayout->isDescriptorBuffer())
+        m_descriptorBuffers.clear();
+
+    m_pipelineLayout = createPipelineLayout(m_descriptorSetLayout);
+
+    // Same set layouts as in the pipeline layout
+    m_setLayouts.clear();
+    if (m_bindlessTable || !m_descriptorSetLayout->isEmpty())
+        m_setLayouts.push_back(*static_cast<const vk::DescriptorSetLayout *>(*m_descriptorSetLayout));
+    if (m_bindlessTable)
+        m_setLayouts.push_back(m_bindlessTable->descriptorSetLayout());
+}
+shared_ptr<const vk::PipelineLayout> Pipeline::createPipelineLayout(const shared_ptr<DescriptorSetLayout> &descriptorSetLayout) const
+{
+    const auto maxPushConstantsSize = m_device->physicalDevice()->limits().maxPushConstantsSize;
+    if (m_pushConstants.size() > maxPushConstantsSize)
+        throw vk::LogicError("Push constants size exceeded: " + to_string(m_pushConstants.size()) + " > " + to_string(maxPushConstantsSize));
+
+    return m_device->layoutCache()->pipelineLayout(
+        descriptorSetLayout,
+        m_pushConstantsShaderStageFlags,
+        m_pushConstants.size(),
+        m_bindlessTable ? m_bindlessTable->descriptorSetLayout() : nullptr
+    );
+}
+
+Pipeline::Variant Pipeline::getVariant()
+{
+    Variant variant;
+    variant.customSpecializationData = m_customSpecializationData;
+    variant.shaderObjects = usesShaderObjects();
+    appendVariantData(variant.data);
+    if (m_descriptorSetLayout->isDescriptorBuffer() && !variant.shaderObjects)
+        variant.createFlags = vk::PipelineCreateFlagBits::eDescriptorBufferEXT;
+    return variant;
+}
+
+Pipeline::Program Pipeline::createProgram(
+    const Variant &variant,
+    vk::PipelineLayout pipelineLayout,
+    const vector<vk::DescriptorSetLayout> &setLayouts) const
+{
+    const auto t1 = chrono::steady_clock::now();
+
+    Program program;
+    if (variant.shaderObjects)
+        program = createShaders(variant, setLayouts);
+    else
+        createPipeline(variant, pipelineLayout, program);
+
+    if (program.creationFeedback.flags & vk::PipelineCreationFeedbackFlagBits::eValid)
+        program.duration = chrono::nanoseconds(program.creationFeedback.duration);
+    else
+        program.duration = chrono::steady_clock::now() - t1;
+
+    return program;
+}
+void Pipeline::bindProgram(const Program &program)
+{
+    m_pipeline = *program.pipeline;
+    m_shaderStages = program.shaderStages;
+    m_shaders.clear();
+    for (auto &&shader : program.shaders)
+        m_shaders.push_back(*shader);
+}
+void Pipeline::unbindProgram()
+{
+    m_pipeline = nullptr;
+    m_shaderStages.clear();
+    m_shaders.clear();
+}
+
+bool Pipeline::usePipelineVariant(const Variant &variant)
+{
+    auto it = find_if(m_variants.begin(), m_variants.end(), [&](auto &&pipelineVariant) {
+        return (pipelineVariant.first == variant);
+    });
+    if (it == m_variants.end())
+        return false;
+
+    m_variants.splice(m_variants.begin(), m_variants, it);
+    bindProgram(m_variants.front().second);
+    return true;
+}
+const Pipeline::Program &Pipeline::addPipelineVariant(Variant &&variant, Program &&program)
+{
+    if (!variant.shaderObjects)
+        recordManifestEntry(variant);
+
+    auto &creationStats = m_creationStats;
+    creationStats.hasFeedback = static_cast<bool>(program.creationFeedback.flags & vk::PipelineCreationFeedbackFlagBits::eValid);
+    creationStats.cacheHit = static_cast<bool>(program.creationFeedback.flags & vk::PipelineCreationFeedbackFlagBits::eApplicationPipelineCacheHit);
+    creationStats.duration = program.duration;
+    creationStats.stageDurations.clear();
+    for (size_t i = 0; i < program.stageCreationFeedbacks.size(); ++i)
+    {
+        const auto &stageCreationFeedback = program.stageCreationFeedbacks[i];
+        if (stageCreationFeedback.flags & vk::PipelineCreationFeedbackFlagBits::eValid)
+            creationStats.stageDurations.emplace_back(program.shaderStages[i], chrono::nanoseconds(stageCreationFeedback.duration));
+    }
+    creationStats.count += 1;
+    if (creationStats.cacheHit)
+        creationStats.cacheHits += 1;
+    creationStats.totalDuration += program.duration;
+
+    m_variants.emplace_front(move(variant), move(program));
+    releasePipelineVariants(m_maxVariants);
+    return m_variants.front().second;
+}
+void Pipeline::releasePipelineVariants(uint32_t maxVariants)
+{
+    while (m_variants.size() > maxVariants)
+    {
+        auto &program = m_variants.back().second;
+
+        const bool isBound = program.pipeline
+            ? (*program.pipeline == m_pipeline)
+            : (!m_shaders.empty() && !program.shaders.empty() && *program.shaders[0] == m_shaders[0])
+        ;
+        if (isBound)
+            unbindProgram();
+
+        vector<vk::ShaderEXT> shaders;
+        for (auto &&shader : program.shaders)
         {
-            pipelineLayoutInfo.pushConstantRangeCount = 1;
-            pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+            if (shader)
+                shaders.push_back(shader.release());
         }
-        m_pipelineLayout = m_device->createPipelineLayoutUnique(pipelineLayoutInfo, nullptr, m_dld);
 
-        createPipeline();
-        m_mustRecreate = false;
+        // The pipeline or shaders can still be used by submitted command buffers
+        m_device->deferRelease([device = m_device.get(), pipeline = program.pipeline.release(), shaders = move(shaders)] {
+            if (pipeline)
+                device->destroyPipeline(pipeline, device->allocationCallbacks(), device->dld());
+            for (auto &&shader : shaders)
+                device->destroyShaderEXT(shader, device->allocationCallbacks(), device->dld());
+        });
+        m_variants.pop_back();
+    }
+}
+
+bool Pipeline::finishPendingVariant(bool wait)
+{
+    if (!m_pendingProgram.valid())
+        return true;
+
+    if (!wait && m_pendingProgram.wait_for(chrono::seconds(0)) != future_status::ready)
+        return false;
+
+    // Rethrows the exception from the worker thread, if any
+    auto program = m_pendingProgram.get();
+    addPipelineVariant(move(m_pendingVariant), move(program));
+    return true;
+}
+
+void Pipeline::recordManifestEntry(const Variant &variant)
+{
+    auto pipelineManifest = m_device->pipelineManifest();
+    if (!pipelineManifest->isRecording())
+        return;
+
+    PipelineManifest::Entry entry;
+    fillManifestEntry(entry);
+    entry.customSpecializationData = variant.customSpecializationData;
+    entry.variantData = variant.data;
+    entry.descriptorTypes = m_descriptorSetLayout->descriptorTypes();
+    entry.pushConstantsSize = m_pushConstants.size();
+    pipelineManifest->record(move(entry));
+}
+void Pipeline::warmUp(const vector<DescriptorType> &descriptorTypes, const Variant &variant) const
+{
+    // The pipeline is stored in the pipeline cache, so it's not kept
+    const bool descriptorBuffer = (!m_pushDescriptors && canUseDescriptorBuffer(descriptorTypes));
+    auto descriptorSetLayout = m_device->layoutCache()->descriptorSetLayout(
+        descriptorTypes,
+        descriptorBuffer
+            ? DescriptorSetLayout::Mode::DescriptorBuffer
+            : DescriptorSetLayout::Mode::DescriptorSet
+    );
+    auto pipelineLayout = createPipelineLayout(descriptorSetLayout);
+    Program program;
+    if (descriptorBuffer)
+    {
+        auto descriptorBufferVariant = variant;
+        descriptorBufferVariant.createFlags = vk::PipelineCreateFlagBits::eDescriptorBufferEXT;
+        createPipeline(descriptorBufferVariant, *pipelineLayout, program);
+    }
+    else
+    {
+        createPipeline(variant, *pipelineLayout, program);
     }
 }
 
@@ -204,7 +817,9 @@ void Pipeline::prepareObjects(
     const shared_ptr<CommandBuffer> &commandBuffer,
     const MemoryObjectDescrs &memoryObjects)
 {
-    memoryObjects.prepareObjects(*commandBuffer, m_objectsPipelineStageFlags);
+    BarrierBatch barrierBatch(*commandBuffer, *m_device);
+    memoryObjects.prepareObjects(barrierBatch, m_objectsPipelineStageFlags);
+    barrierBatch.flush();
 }
 void Pipeline::prepareObjects(
     const shared_ptr<CommandBuffer> &commandBuffer)
@@ -218,7 +833,9 @@ void Pipeline::finalizeObjects(
     bool genMipmapsOnWrite,
     bool resetPipelineStageFlags)
 {
-    memoryObjects.finalizeObjects(*commandBuffer, genMipmapsOnWrite, resetPipelineStageFlags);
+    BarrierBatch barrierBatch(*commandBuffer, *m_device);
+    memoryObjects.finalizeObjects(barrierBatch, genMipmapsOnWrite, resetPipelineStageFlags);
+    barrierBatch.flush();
 }
 void Pipeline::finalizeObjects(
     const shared_ptr<CommandBuffer> &commandBuffer,
@@ -9,7 +9,11 @@
 #include "QmVkExport.hpp"
 
 #include "MemoryObjectDescrs.hpp"
+#include "PipelineManifest.hpp"
 
+#include <chrono>
+#include <future>
+#include <list>
 #include <map>
 
 namespace QmVk {
@@ -22,9 +26,14 @@ class DescriptorSetLayout;
 class DescriptorPool;
 class DescriptorSet;
 class CommandBuffer;
+class Queue;
+class Buffer;
+class BindlessTable;
 
 class QMVK_EXPORT Pipeline
 {
+    friend class PipelineManifest;
+
 protected:
     Pipeline(
         const shared_ptr<Device> &device,
@@ -35,14 +44,76 @@ protected:
     ~Pipeline();
 
 protected:
-    virtual void createPipeline() = 0;
+    // Pipelines built from the same layout are distinguished by the variant
+    struct Variant
+    {
+        map<vk::ShaderStageFlagBits, vector<uint32_t>> customSpecializationData;
+        vector<uint32_t> data; // pipeline specific, e.g. local workgroup size
+        vk::PipelineCreateFlags createFlags; // depends on the layout, e.g. descriptor buffer
+        bool shaderObjects = false;
+
+        inline bool operator==(const Variant &other) const;
+    };
+
+    // Compiled variant, either a pipeline or shader objects
+    struct Program
+    {
+        vk::UniquePipeline pipeline;
+        vector<vk::ShaderStageFlagBits> shaderStages;
+        vector<vk::UniqueShaderEXT> shaders; // null shader unbinds the stage
+
+        // Creation feedback is filled only for pipelines, stages are in order of "shaderStages"
+        vk::PipelineCreationFeedback creationFeedback;
+        vector<vk::PipelineCreationFeedback> stageCreationFeedbacks;
+        chrono::nanoseconds duration {0};
+    };
+
+public:
+    struct CreationStats
+    {
+        uint32_t count = 0; // number of created variants, e.g. after a resize or new specialization data
+        uint32_t cacheHits = 0; // requires pipeline creation feedback
+        chrono::nanoseconds totalDuration {0};
+
+        // The most recently created variant
+        bool hasFeedback = false;
+        bool cacheHit = false;
+        chrono::nanoseconds duration {0}; // from creation feedback or measured
+        vector<pair<vk::ShaderStageFlagBits, chrono::nanoseconds>> stageDurations; // requires pipeline creation feedback
+    };
+
+protected:
+    // Can be called from a worker thread, so it must depend only on the arguments and immutable data
+    virtual void createPipeline(const Variant &variant, vk::PipelineLayout pipelineLayout, Program &program) const = 0;
+    // Used instead of "createPipeline()" for shader objects, same rules apply
+    virtual Program createShaders(const Variant &variant, const vector<vk::DescriptorSetLayout> &setLayouts) const = 0;
+    virtual bool canUseShaderObjects() const;
+    virtual void appendVariantData(vector<uint32_t> &variantData);
+
+    // Fills the pipeline type and shaders
+    virtual void fillManifestEntry(PipelineManifest::Entry &entry) const = 0;
 
     void setCustomSpecializationData(
         const vector<uint32_t> &data,
         vk::ShaderStageFlagBits shaderStageFlag
     );
 
+    // Chains creation feedback for all shader stages of the program into "pNext", if supported
+    void prepareCreationFeedback(
+        Program &program,
+        vk::PipelineCreationFeedbackCreateInfo &creationFeedbackCreateInfo,
+        const void *&pNext
+    ) const;
+    void addCreationFeedback(const Program &program) const;
+
+    // Fills the layout of all shaders and creates them at once
+    Program createShaderObjects(
+        vector<vk::ShaderCreateInfoEXT> &shaderCreateInfos,
+        const vector<vk::DescriptorSetLayout> &setLayouts
+    ) const;
+
     vk::SpecializationInfo getSpecializationInfo(
+        const Variant &variant,
         vk::ShaderStageFlagBits shaderStageFlag,
         vector<vk::SpecializationMapEntry> &specializationMapEntries,
         vector<uint32_t> &specializationData
@@ -60,11 +131,51 @@ public:
     template<typename T>
     inline T *pushConstants();
 
+    // Maximum number of pipeline variants kept for reuse, least recently used is destroyed first
+    void setMaxVariants(uint32_t maxVariants);
+    inline uint32_t numVariants() const;
+
+    // Statistics of variants created by this pipeline, see also "PipelineCache" for device-wide statistics
+    inline const CreationStats &creationStats() const;
+
+    // Pushes descriptors into the command buffer instead of using a descriptor set, bindings can be changed
+    // without waiting for the previous submission. Not used if unsupported, if descriptors don't fit into
+    // "maxPushDescriptors" or if a descriptor set is created from a pool.
+    void setPushDescriptors(bool pushDescriptors);
+    bool usesPushDescriptors() const;
+
+    // Number of descriptor sets allocated at once and cycled through when memory objects change. New
+    // bindings are written to a set which is not used by any command buffer, so the previous frame can
+    // still be executed. If all of them are in use, finished submissions are collected first, then more
+    // sets are allocated up to 4 times the ring size, then the queue is waited for.
+    void setDescriptorSetsRingSize(uint32_t size);
+
+    // Descriptors are written into a buffer instead of a descriptor set if the device was created with
+    // descriptor buffer enabled. Not used with push descriptors, bindless table or a descriptor set from
+    // a pool, or if any descriptor type isn't supported by the descriptor buffer.
+    bool usesDescriptorBuffer() const;
+
+    // Uses shader objects instead of pipeline objects if supported, all state is set while recording.
+    // Otherwise pipelines are used.
+    void setShaderObjects(bool shaderObjects);
+    bool usesShaderObjects() const;
+
+    // The bindless table is bound as descriptor set 1
+    void setBindlessTable(const shared_ptr<BindlessTable> &bindlessTable);
+    inline shared_ptr<BindlessTable> bindlessTable() const;
+
     void createDescriptorSetFromPool(const shared_ptr<DescriptorPool> &descriptorPool);
     void setMemoryObjects(const MemoryObjectDescrs &memoryObjects);
 
     void prepare();
 
+    // Compiles a new pipeline on a worker thread, returns true if the pipeline is ready to use
+    bool prepareAsync();
+    inline bool isReady() const;
+
+    // The previous pipeline can be used while the new one is being compiled, if the layout is the same
+    inline bool hasPipeline() const;
+
     void prepareObjects(
         const shared_ptr<CommandBuffer> &commandBuffer,
         const MemoryObjectDescrs &memoryObjects
@@ -85,6 +196,41 @@ public:
         bool resetPipelineStageFlags
     );
 
+private:
+    bool canUsePushDescriptors(const vector<DescriptorType> &descriptorTypes) const;
+    void pushDescriptors(
+        const shared_ptr<CommandBuffer> &commandBuffer,
+        vk::PipelineBindPoint pipelineBindPoint
+    );
+
+    bool canUseDescriptorBuffer(const vector<DescriptorType> &descriptorTypes) const;
+    shared_ptr<Buffer> acquireDescriptorBuffer();
+
+    shared_ptr<DescriptorSet> acquireDescriptorSet();
+
+    void prepareLayout();
+    void createPipelineLayout();
+    shared_ptr<const vk::PipelineLayout> createPipelineLayout(const shared_ptr<DescriptorSetLayout> &descriptorSetLayout) const;
+
+    Variant getVariant();
+
+    Program createProgram(
+        const Variant &variant,
+        vk::PipelineLayout pipelineLayout,
+        const vector<vk::DescriptorSetLayout> &setLayouts
+    ) const;
+    void bindProgram(const Program &program);
+    void unbindProgram();
+
+    bool usePipelineVariant(const Variant &variant);
+    const Program &addPipelineVariant(Variant &&variant, Program &&program);
+    void releasePipelineVariants(uint32_t maxVariants);
+
+    bool finishPendingVariant(bool wait);
+
+    void recordManifestEntry(const Variant &variant);
+    void warmUp(const vector<DescriptorType> &descriptorTypes, const Variant &variant) const;
+
 protected:
     const shared_ptr<Device> m_device;
     const vk::detail::DispatchLoaderDynamic &m_dld;
@@ -96,18 +242,78 @@ protected:
     vector<uint8_t> m_pushConstants;
     MemoryObjectDescrs m_memoryObjects;
 
+    bool m_pushDescriptors = false;
+    bool m_shaderObjects = false;
     bool m_mustUpdateDescriptorInfos = false;
+    bool m_mustRecreateLayout = true;
     bool m_mustRecreate = true;
 
     shared_ptr<DescriptorSetLayout> m_descriptorSetLayout;
     shared_ptr<DescriptorSet> m_descriptorSet;
 
-    vk::UniquePipelineLayout m_pipelineLayout;
-    vk::UniquePipeline m_pipeline;
+    uint32_t m_descriptorSetsRingSize = 1;
+    uint32_t m_descriptorSetsRingIdx = 0;
+    vector<shared_ptr<DescriptorSet>> m_descriptorSetsRing;
+    weak_ptr<Queue> m_descriptorSetsQueue; // last queue the ring was used on
+
+    shared_ptr<BindlessTable> m_bindlessTable;
+
+    shared_ptr<Buffer> m_descriptorBuffer;
+    uint32_t m_descriptorBuffersIdx = 0;
+    vector<shared_ptr<Buffer>> m_descriptorBuffers;
+
+    vector<DescriptorInfo> m_pushDescriptorInfos;
+    vk::UniqueDescriptorUpdateTemplate m_pushDescriptorUpdateTemplate;
+
+    shared_ptr<const vk::PipelineLayout> m_pipelineLayout;
+    vector<vk::DescriptorSetLayout> m_setLayouts; // for shader objects
+
+    // Either a pipeline or shader objects is bound
+    vk::Pipeline m_pipeline;
+    vector<vk::ShaderStageFlagBits> m_shaderStages;
+    vector<vk::ShaderEXT> m_shaders;
+
+private:
+    uint32_t m_maxVariants = 8;
+    list<pair<Variant, Program>> m_variants; // most recently used first
+
+    Variant m_pendingVariant;
+    future<Program> m_pendingProgram;
+
+    CreationStats m_creationStats;
 };
 
 /* Inline implementation */
 
+bool Pipeline::Variant::operator==(const Variant &other) const
+{
+    return (customSpecializationData == other.customSpecializationData && data == other.data && createFlags == other.createFlags && shaderObjects == other.shaderObjects);
+}
+
+uint32_t Pipeline::numVariants() const
+{
+    return m_variants.size();
+}
+
+const Pipeline::CreationStats &Pipeline::creationStats() const
+{
+    return m_creationStats;
+}
+
+shared_ptr<BindlessTable> Pipeline::bindlessTable() const
+{
+    return m_bindlessTable;
+}
+
+bool Pipeline::isReady() const
+{
+    return (hasPipeline() && !m_mustRecreateLayout && !m_mustRecreate);
+}
+bool Pipeline::hasPipeline() const
+{
+    return (m_pipeline || !m_shaders.empty());
+}
+
 template<typename T>
 T *Pipeline::pushConstants()
 {
@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: MIT
+/*
+   QmVk - simple Vulkan library created for QMPlay2
+   Copyright (C) 2020-2025 Błażej Szczygieł
+*/
+
+#include "PipelineCache.hpp"
+#include "PhysicalDevice.hpp"
+#include "Device.hpp"
+
+#include <fstream>
+#include <cstring>
+
+namespace QmVk {
+
+struct PipelineCache::FileHeader
+{
+    static constexpr uint32_t s_magic = 0x43506d51; // "QmPC"
+    static constexpr uint32_t s_version = 1;
+
+    uint32_t magic = s_magic;
+    uint32_t version = s_version;
+    uint32_t vendorID = 0;
+    uint32_t deviceID = 0;
+    uint32_t driverVersion = 0;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE] = {};
+    uint64_t dataSize = 0;
+
+    inline bool operator==(const FileHeader &other) const
+    {
+        return (magic == other.magic
+            && version == other.version
+            && vendorID == other.vendorID
+            && deviceID == other.deviceID
+            && driverVersion == other.driverVersion
+            && memcmp(pipelineCacheUUID, other.pipelineCacheUUID, VK_UUID_SIZE) == 0
+        );
+    }
+};
+
+PipelineCache::PipelineCache(Device &device)
+    : m_device(device)
+{
+    m_pipelineCache = m_device.createPipelineCache(vk::PipelineCacheCreateInfo(), m_device.allocationCallbacks(), m_device.dld());
+}
+PipelineCache::~PipelineCache()
+{
+    m_device.destroyPipelineCache(m_pipelineCache, m_device.allocationCallbacks(), m_device.dld());
+}
+
+shared_lock<shared_mutex> PipelineCache::lockShared() const
+{
+    return shared_lock<shared_mutex>(m_mutex);
+}
+
+bool PipelineCache::load(const string &fileName)
+{
+    ifstream file(fileName, ios::binary);
+    if (!file)
+        return false;
+
+    FileHeader fileHeader;
+    if (!file.read(reinterpret_cast<char *>(&fileHeader), sizeof(fileHeader)))
+        return false;
+
+    if (!(fileHeader == getFileHeader()) || fileHeader.dataSize == 0)
+        return false;
+
+    vector<uint8_t> data(fileHeader.dataSize);
+    if (!file.read(reinterpret_cast<char *>(data.data()), data.size()))
+        return false;
+
+    vk::PipelineCacheCreateInfo pipelineCacheCreateInfo;
+    pipelineCacheCreateInfo.initialDataSize = data.size();
+    pipelineCacheCreateInfo.pInitialData = data.data();
+
+    auto loadedPipelineCache = m_device.createPipelineCacheUnique(pipelineCacheCreateInfo, m_device.allocationCallbacks(), m_device.dld());
+
+    // Merging requires external synchronization of the destination cache, pipelines can't be created meanwhile
+    lock_guard<shared_mutex> locker(m_mutex);
+    m_device.mergePipelineCaches(m_pipelineCache, *loadedPipelineCache, m_device.dld());
+
+    return true;
+}
+bool PipelineCache::save(const string &fileName) const
+{
+    const auto data = this->data();
+    if (data.empty())
+        return false;
+
+    auto fileHeader = getFileHeader();
+    fileHeader.dataSize = data.size();
+
+    ofstream file(fileName, ios::binary | ios::trunc);
+    if (!file)
+        return false;
+
+    file.write(reinterpret_cast<const char *>(&fileHeader), sizeof(fileHeader));
+    file.write(reinterpret_cast<const char *>(data.data()), data.size());
+    return static_cast<bool>(file);
+}
+
+vector<uint8_t> PipelineCache::data() const
+{
+    return m_device.getPipelineCacheData(m_pipelineCache, m_device.dld());
+}
+
+void PipelineCache::addFeedback(
+    const vk::PipelineCreationFeedback &creationFeedback,
+    const vector<vk::PipelineCreationFeedback> &stageCreationFeedbacks)
+{
+    if (!(creationFeedback.flags & vk::PipelineCreationFeedbackFlagBits::eValid))
+        return;
+
+    if (creationFeedback.flags & vk::PipelineCreationFeedbackFlagBits::eApplicationPipelineCacheHit)
+        ++m_hits;
+    else
+        ++m_misses;
+
+    m_durationNs += creationFeedback.duration;
+    for (auto &&stageCreationFeedback : stageCreationFeedbacks)
+    {
+        if (stageCreationFeedback.flags & vk::PipelineCreationFeedbackFlagBits::eValid)
+            m_stagesDurationNs += stageCreationFeedback.duration;
+    }
+}
+void PipelineCache::resetStats()
+{
+    m_hits = 0;
+    m_misses = 0;
+    m_durationNs = 0;
+    m_stagesDurationNs = 0;
+}
+
+PipelineCache::FileHeader PipelineCache::getFileHeader() const
+{
+    const auto &properties = m_device.physicalDevice()->properties();
+
+    FileHeader fileHeader;
+    fileHeader.vendorID = properties.vendorID;
+    fileHeader.deviceID = properties.deviceID;
+    fileHeader.driverVersion = properties.driverVersion;
+    memcpy(fileHeader.pipelineCacheUUID, properties.pipelineCacheUUID.data(), VK_UUID_SIZE);
+    return fileHeader;
+}
+
+}
@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: MIT
+/*
+   QmVk - simple Vulkan library created for QMPlay2
+   Copyright (C) 2020-2025 Błażej Szczygieł
+*/
+
+#pragma once
+
+#include "QmVkExport.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <shared_mutex>
+
+namespace QmVk {
+
+using namespace std;
+
+class Device;
+
+/*
+ * Device-wide pipeline cache used by all pipelines. It can be stored to and
+ * restored from a file, the file is rejected if it was created on a different
+ * device or driver.
+ */
+class QMVK_EXPORT PipelineCache
+{
+    struct FileHeader;
+
+public:
+    PipelineCache(Device &device);
+    ~PipelineCache();
+
+public:
+    inline operator vk::PipelineCache() const;
+
+    // Must be held while creating pipelines with the cache, "load()" merges exclusively
+    shared_lock<shared_mutex> lockShared() const;
+
+    // Merges the cache stored in the file, returns false if the file is missing or incompatible
+    bool load(const string &fileName);
+    bool save(const string &fileName) const;
+
+    vector<uint8_t> data() const;
+
+    // Updates statistics, "creationFeedback" is ignored if it's not valid
+    void addFeedback(
+        const vk::PipelineCreationFeedback &creationFeedback,
+        const vector<vk::PipelineCreationFeedback> &stageCreationFeedbacks = {}
+    );
+
+    // Statistics of all pipelines created on the device, available only with "VK_EXT_pipeline_creation_feedback"
+    inline uint64_t hits() const;
+    inline uint64_t misses() const;
+    inline chrono::nanoseconds duration() const;
+    inline chrono::nanoseconds stagesDuration() const;
+    void resetStats();
+
+private:
+    FileHeader getFileHeader() const;
+
+private:
+    Device &m_device;
+
+    vk::PipelineCache m_pipelineCache;
+    mutable shared_mutex m_mutex;
+
+    atomic<uint64_t> m_hits {0};
+    atomic<uint64_t> m_misses {0};
+    atomic<uint64_t> m_durationNs {0};
+    atomic<uint64_t> m_stagesDurationNs {0};
+};
+
+/* Inline implementation */
+
+PipelineCache::operator vk::PipelineCache() const
+{
+    return m_pipelineCache;
+}
+
+uint64_t PipelineCache::hits() const
+{
+    return m_hits;
+}
+uint64_t PipelineCache::misses() const
+{
+    return m_misses;
+}
+chrono::nanoseconds PipelineCache::duration() const
+{
+    return chrono::nanoseconds(m_durationNs);
+}
+chrono::nanoseconds PipelineCache::stagesDuration() const
+{
+    return chrono::nanoseconds(m_stagesDurationNs);
+}
+
+}
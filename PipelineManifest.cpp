@@ -0,0 +1,312 @@
+// SPDX-License-Identifier: MIT
+/*
+   QmVk - simple Vulkan library created for QMPlay2
+   Copyright (C) 2020-2025 Błażej Szczygieł
+*/
+
+#include "PipelineManifest.hpp"
+#include "ComputePipeline.hpp"
+#ifndef QMVK_NO_GRAPHICS
+#   include "GraphicsPipeline.hpp"
+#endif
+#include "ShaderModule.hpp"
+#include "WorkerPool.hpp"
+#include "Device.hpp"
+
+#include <algorithm>
+#include <fstream>
+
+namespace QmVk {
+
+constexpr uint32_t g_magic = 0x4d506d51; // "QmPM"
+constexpr uint32_t g_version = 1;
+
+static void writeVector(vector<uint32_t> &words, const vector<uint32_t> &data)
+{
+    words.push_back(data.size());
+    words.insert(words.end(), data.begin(), data.end());
+}
+static bool readWord(const vector<uint32_t> &words, size_t &pos, uint32_t &word)
+{
+    if (pos >= words.size())
+        return false;
+    word = words[pos++];
+    return true;
+}
+static bool readVector(const vector<uint32_t> &words, size_t &pos, vector<uint32_t> &data)
+{
+    uint32_t size = 0;
+    if (!readWord(words, pos, size) || size > words.size() - pos)
+        return false;
+    data.assign(words.begin() + pos, words.begin() + pos + size);
+    pos += size;
+    return true;
+}
+
+static void writeEntry(vector<uint32_t> &words, const PipelineManifest::Entry &entry)
+{
+    words.push_back(static_cast<uint32_t>(entry.bindPoint));
+    words.push_back(entry.dispatchBase);
+
+    words.push_back(entry.shaderHashes.size());
+    for (auto &&shaderHash : entry.shaderHashes)
+    {
+        words.push_back(shaderHash);
+        words.push_back(shaderHash >> 32);
+    }
+
+    words.push_back(entry.customSpecializationData.size());
+    for (auto &&customSpecializationData : entry.customSpecializationData)
+    {
+        words.push_back(static_cast<uint32_t>(customSpecializationData.first));
+        writeVector(words, customSpecializationData.second);
+    }
+
+    writeVector(words, entry.variantData);
+
+    words.push_back(entry.descriptorTypes.size());
+    for (auto &&descriptorType : entry.descriptorTypes)
+    {
+        words.push_back(static_cast<uint32_t>(descriptorType.type));
+        words.push_back(descriptorType.descriptorCount);
+    }
+
+    words.push_back(entry.pushConstantsSize);
+}
+static bool readEntry(const vector<uint32_t> &words, size_t &pos, PipelineManifest::Entry &entry)
+{
+    uint32_t word = 0;
+
+    if (!readWord(words, pos, word))
+        return false;
+    entry.bindPoint = static_cast<vk::PipelineBindPoint>(word);
+
+    if (!readWord(words, pos, word))
+        return false;
+    entry.dispatchBase = (word != 0);
+
+    uint32_t count = 0;
+
+    if (!readWord(words, pos, count) || count > (words.size() - pos) / 2)
+        return false;
+    entry.shaderHashes.resize(count);
+    for (auto &&shaderHash : entry.shaderHashes)
+    {
+        shaderHash = words[pos] | (static_cast<uint64_t>(words[pos + 1]) << 32);
+        pos += 2;
+    }
+
+    if (!readWord(words, pos, count))
+        return false;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (!readWord(words, pos, word))
+            return false;
+        if (!readVector(words, pos, entry.customSpecializationData[static_cast<vk::ShaderStageFlagBits>(word)]))
+            return false;
+    }
+
+    if (!readVector(words, pos, entry.variantData))
+        return false;
+
+    if (!readWord(words, pos, count) || count > (words.size() - pos) / 2)
+        return false;
+    entry.descriptorTypes.resize(count);
+    for (auto &&descriptorType : entry.descriptorTypes)
+    {
+        descriptorType.type = static_cast<vk::DescriptorType>(words[pos++]);
+        descriptorType.descriptorCount = words[pos++];
+    }
+
+    return readWord(words, pos, entry.pushConstantsSize);
+}
+
+bool PipelineManifest::Entry::operator==(const Entry &other) const
+{
+    return (bindPoint == other.bindPoint
+        && dispatchBase == other.dispatchBase
+        && shaderHashes == other.shaderHashes
+        && customSpecializationData == other.customSpecializationData
+        && variantData == other.variantData
+        && descriptorTypes == other.descriptorTypes
+        && pushConstantsSize == other.pushConstantsSize
+    );
+}
+
+PipelineManifest::PipelineManifest(Device &device)
+    : m_device(device)
+{}
+PipelineManifest::~PipelineManifest()
+{}
+
+void PipelineManifest::record(Entry &&entry)
+{
+#ifndef QMVK_NO_GRAPHICS
+    // Immutable samplers can't be restored from a file
+    for (auto &&descriptorType : entry.descriptorTypes)
+    {
+        if (!descriptorType.immutableSamplers.empty())
+            return;
+    }
+#endif
+
+    lock_guard<mutex> locker(m_mutex);
+    if (find(m_entries.begin(), m_entries.end(), entry) == m_entries.end())
+        m_entries.push_back(move(entry));
+}
+
+vector<PipelineManifest::Entry> PipelineManifest::entries() const
+{
+    lock_guard<mutex> locker(m_mutex);
+    return m_entries;
+}
+void PipelineManifest::clear()
+{
+    lock_guard<mutex> locker(m_mutex);
+    m_entries.clear();
+}
+
+bool PipelineManifest::load(const string &fileName)
+{
+    ifstream file(fileName, ios::binary | ios::ate);
+    if (!file)
+        return false;
+
+    const auto fileSize = static_cast<size_t>(file.tellg());
+    if (fileSize % sizeof(uint32_t) != 0)
+        return false;
+
+    vector<uint32_t> words(fileSize / sizeof(uint32_t));
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char *>(words.data()), fileSize))
+        return false;
+
+    size_t pos = 0;
+    uint32_t word = 0;
+
+    if (!readWord(words, pos, word) || word != g_magic)
+        return false;
+    if (!readWord(words, pos, word) || word != g_version)
+        return false;
+
+    uint32_t count = 0;
+    if (!readWord(words, pos, count))
+        return false;
+
+    vector<Entry> entries(count);
+    for (auto &&entry : entries)
+    {
+        if (!readEntry(words, pos, entry))
+            return false;
+    }
+
+    for (auto &&entry : entries)
+        record(move(entry));
+
+    return true;
+}
+bool PipelineManifest::save(const string &fileName) const
+{
+    vector<uint32_t> words {
+        g_magic,
+        g_version,
+    };
+
+    {
+        lock_guard<mutex> locker(m_mutex);
+        words.push_back(m_entries.size());
+        for (auto &&entry : m_entries)
+            writeEntry(words, entry);
+    }
+
+    ofstream file(fileName, ios::binary | ios::trunc);
+    if (!file)
+        return false;
+
+    file.write(reinterpret_cast<const char *>(words.data()), words.size() * sizeof(uint32_t));
+    return static_cast<bool>(file);
+}
+
+uint32_t PipelineManifest::warmUp(
+    const vector<shared_ptr<ShaderModule>> &shaderModules
+#ifndef QMVK_NO_GRAPHICS
+    , const vector<shared_ptr<GraphicsPipeline>> &graphicsPipelines
+#endif
+)
+{
+    const auto device = m_device.shared_from_this();
+
+    auto findShaderModule = [&](uint64_t hash) {
+        auto it = find_if(shaderModules.begin(), shaderModules.end(), [=](auto &&shaderModule) {
+            return (shaderModule->hash() == hash);
+        });
+        return (it != shaderModules.end()) ? *it : nullptr;
+    };
+
+    vector<future<void>> results;
+
+    for (auto &&entry : entries())
+    {
+        shared_ptr<Pipeline> pipeline;
+
+        if (entry.bindPoint == vk::PipelineBindPoint::eCompute)
+        {
+            if (entry.shaderHashes.size() != 1 || entry.variantData.size() < 2)
+                continue;
+
+            auto shaderModule = findShaderModule(entry.shaderHashes[0]);
+            if (!shaderModule || shaderModule->stage() != vk::ShaderStageFlagBits::eCompute)
+                continue;
+
+            pipeline = ComputePipeline::create(
+                device,
+                shaderModule,
+                entry.pushConstantsSize,
+                entry.dispatchBase
+            );
+        }
+#ifndef QMVK_NO_GRAPHICS
+        else if (entry.bindPoint == vk::PipelineBindPoint::eGraphics)
+        {
+            for (shared_ptr<Pipeline> graphicsPipeline : graphicsPipelines)
+            {
+                Entry graphicsEntry;
+                graphicsPipeline->fillManifestEntry(graphicsEntry);
+                if (graphicsEntry.shaderHashes == entry.shaderHashes && graphicsPipeline->m_pushConstants.size() == entry.pushConstantsSize)
+                {
+                    pipeline = move(graphicsPipeline);
+                    break;
+                }
+            }
+        }
+#endif
+
+        if (!pipeline)
+            continue;
+
+        Pipeline::Variant variant;
+        variant.customSpecializationData = entry.customSpecializationData;
+        variant.data = entry.variantData;
+
+        results.push_back(m_device.workerPool()->submit([pipeline, variant, descriptorTypes = entry.descriptorTypes] {
+            pipeline->warmUp(descriptorTypes, variant);
+        }));
+    }
+
+    uint32_t compiled = 0;
+    for (auto &&result : results)
+    {
+        try
+        {
+            result.get();
+            ++compiled;
+        }
+        catch (const vk::Error &)
+        {
+            // The entry is probably outdated, skip it
+        }
+    }
+    return compiled;
+}
+
+}
@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: MIT
+/*
+   QmVk - simple Vulkan library created for QMPlay2
+   Copyright (C) 2020-2025 Błażej Szczygieł
+*/
+
+#pragma once
+
+#include "QmVkExport.hpp"
+
+#include "DescriptorType.hpp"
+
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <map>
+
+namespace QmVk {
+
+using namespace std;
+
+class Device;
+class ShaderModule;
+#ifndef QMVK_NO_GRAPHICS
+class GraphicsPipeline;
+#endif
+
+/*
+ * List of pipeline variants created by the application. It can be recorded
+ * at runtime, stored to a file and replayed on a next start to fill the
+ * pipeline cache before the pipelines are used.
+ */
+class QMVK_EXPORT PipelineManifest
+{
+public:
+    struct Entry
+    {
+        vk::PipelineBindPoint bindPoint = vk::PipelineBindPoint::eCompute;
+        bool dispatchBase = false;
+        vector<uint64_t> shaderHashes; // in shader stage order
+        map<vk::ShaderStageFlagBits, vector<uint32_t>> customSpecializationData;
+        vector<uint32_t> variantData; // e.g. local workgroup size
+        vector<DescriptorType> descriptorTypes;
+        uint32_t pushConstantsSize = 0;
+
+        bool operator==(const Entry &other) const;
+    };
+
+public:
+    PipelineManifest(Device &device);
+    ~PipelineManifest();
+
+public:
+    inline void setRecording(bool recording);
+    inline bool isRecording() const;
+
+    void record(Entry &&entry);
+
+    vector<Entry> entries() const;
+    void clear();
+
+    bool load(const string &fileName);
+    bool save(const string &fileName) const;
+
+    // Compiles all entries in parallel and stores them in the pipeline cache, returns the number of compiled
+    // entries. Graphics entries are compiled only if a matching graphics pipeline is given, because the
+    // manifest doesn't store the render pass and the fixed-function state.
+    uint32_t warmUp(
+        const vector<shared_ptr<ShaderModule>> &shaderModules
+#ifndef QMVK_NO_GRAPHICS
+        , const vector<shared_ptr<GraphicsPipeline>> &graphicsPipelines = {}
+#endif
+    );
+
+private:
+    Device &m_device;
+
+    atomic_bool m_recording {false};
+
+    mutable mutex m_mutex;
+    vector<Entry> m_entries;
+};
+
+/* Inline implementation */
+
+void PipelineManifest::setRecording(bool recording)
+{
+    m_recording = recording;
+}
+bool PipelineManifest::isRecording() const
+{
+    return m_recording;
+}
+
+}
@@ -6,6 +6,8 @@
 
 #include "Queue.hpp"
 #include "Device.hpp"
+#include "Completion.hpp"
+#include "BarrierBatch.hpp"
 
 namespace QmVk {
 
@@ -33,11 +35,33 @@ Queue::Queue(
     , m_queueIndex(queueIndex)
 {}
 Queue::~Queue()
-{}
+{
+    for (auto &&inFlight : m_inFlight)
+    {
+        if (auto completion = inFlight.second.lock())
+            completion->wait();
+    }
+    m_lastCompletion.reset();
+
+    for (auto &&fence : m_freeFences)
+        m_device->destroyFence(fence, m_device->allocationCallbacks(), dld());
+}
 
 void Queue::init()
 {
     static_cast<vk::Queue &>(*this) = m_device->getQueue(m_queueFamilyIndex, m_queueIndex, dld());
+
+    if (m_device->hasTimelineSemaphore())
+    {
+        vk::SemaphoreTypeCreateInfo semaphoreTypeCreateInfo;
+        semaphoreTypeCreateInfo.semaphoreType = vk::SemaphoreType::eTimeline;
+        semaphoreTypeCreateInfo.initialValue = 0;
+
+        vk::SemaphoreCreateInfo semaphoreCreateInfo;
+        semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+
+        m_timelineSemaphore = m_device->createSemaphoreUnique(semaphoreCreateInfo, m_device->allocationCallbacks(), dld());
+    }
 }
 
 unique_lock<mutex> Queue::lock()
@@ -45,34 +69,238 @@ unique_lock<mutex> Queue::lock()
     return unique_lock<mutex>(m_mutex);
 }
 
-void Queue::submitCommandBuffer(vk::SubmitInfo &&submitInfo)
+shared_ptr<Completion> Queue::submitCommandBuffer(vk::SubmitInfo &&submitInfo)
 {
-    if (!m_fence)
+    if (m_device->hasSync2() && !submitInfo.pNext)
+    {
+        vector<vk::SemaphoreSubmitInfo> waitSemaphoreInfos(submitInfo.waitSemaphoreCount);
+        for (uint32_t i = 0; i < submitInfo.waitSemaphoreCount; ++i)
+        {
+            waitSemaphoreInfos[i].semaphore = submitInfo.pWaitSemaphores[i];
+            waitSemaphoreInfos[i].stageMask = BarrierBatch::toStage2(submitInfo.pWaitDstStageMask[i]);
+        }
+
+        vector<vk::CommandBufferSubmitInfo> commandBufferInfos(submitInfo.commandBufferCount);
+        for (uint32_t i = 0; i < submitInfo.commandBufferCount; ++i)
+            commandBufferInfos[i].commandBuffer = submitInfo.pCommandBuffers[i];
+
+        vector<vk::SemaphoreSubmitInfo> signalSemaphoreInfos(submitInfo.signalSemaphoreCount);
+        for (uint32_t i = 0; i < submitInfo.signalSemaphoreCount; ++i)
+        {
+            signalSemaphoreInfos[i].semaphore = submitInfo.pSignalSemaphores[i];
+            signalSemaphoreInfos[i].stageMask = vk::PipelineStageFlagBits2::eAllCommands;
+        }
+
+        vk::SubmitInfo2 submitInfo2;
+        submitInfo2.waitSemaphoreInfoCount = waitSemaphoreInfos.size();
+        submitInfo2.pWaitSemaphoreInfos = waitSemaphoreInfos.data();
+        submitInfo2.commandBufferInfoCount = commandBufferInfos.size();
+        submitInfo2.pCommandBufferInfos = commandBufferInfos.data();
+        submitInfo2.signalSemaphoreInfoCount = signalSemaphoreInfos.size();
+        submitInfo2.pSignalSemaphoreInfos = signalSemaphoreInfos.data();
+        return submitCommandBuffer(move(submitInfo2));
+    }
+
+    const uint64_t value = m_submittedValue + 1;
+    auto completion = createCompletion();
+
+    if (m_timelineSemaphore)
+    {
+        bool hasTimelineSubmitInfo = false;
+        for (auto pNext = reinterpret_cast<const vk::BaseInStructure *>(submitInfo.pNext); pNext; pNext = pNext->pNext)
+        {
+            if (pNext->sType == vk::StructureType::eTimelineSemaphoreSubmitInfo)
+            {
+                hasTimelineSubmitInfo = true;
+                break;
+            }
+        }
+
+        vk::TimelineSemaphoreSubmitInfo timelineSubmitInfo;
+        vector<vk::Semaphore> signalSemaphores;
+        vector<uint64_t> signalValues;
+
+        if (!hasTimelineSubmitInfo)
+        {
+            // Append the timeline semaphore to the signal semaphores, binary semaphore values are ignored
+            signalSemaphores.assign(submitInfo.pSignalSemaphores, submitInfo.pSignalSemaphores + submitInfo.signalSemaphoreCount);
+            signalSemaphores.push_back(*m_timelineSemaphore);
+            signalValues.resize(signalSemaphores.size());
+            signalValues.back() = value;
+
+            timelineSubmitInfo.signalSemaphoreValueCount = signalValues.size();
+            timelineSubmitInfo.pSignalSemaphoreValues = signalValues.data();
+            timelineSubmitInfo.pNext = submitInfo.pNext;
+
+            submitInfo.signalSemaphoreCount = signalSemaphores.size();
+            submitInfo.pSignalSemaphores = signalSemaphores.data();
+            submitInfo.pNext = &timelineSubmitInfo;
+        }
+
+        submit(submitInfo, completion->fence(), dld());
+        completion->m_submitted = true;
+
+        if (hasTimelineSubmitInfo)
+        {
+            // Signal operation waits for all previously submitted commands
+            timelineSubmitInfo.signalSemaphoreValueCount = 1;
+            timelineSubmitInfo.pSignalSemaphoreValues = &value;
+
+            vk::SubmitInfo signalSubmitInfo;
+            signalSubmitInfo.pNext = &timelineSubmitInfo;
+            signalSubmitInfo.signalSemaphoreCount = 1;
+            signalSubmitInfo.pSignalSemaphores = &*m_timelineSemaphore;
+            submit(signalSubmitInfo, nullptr, dld());
+        }
+    }
+    else
     {
-        m_fence = m_device->createFenceUnique(vk::FenceCreateInfo(), nullptr, dld());
+        submit(submitInfo, completion->fence(), dld());
+        completion->m_submitted = true;
     }
-    else if (m_fenceResetNeeded)
+
+    addInFlight(completion, value);
+    return completion;
+}
+shared_ptr<Completion> Queue::submitCommandBuffer(vk::SubmitInfo2 &&submitInfo)
+{
+    if (!m_device->hasSync2())
+        throw vk::LogicError("Synchronization2 is not enabled");
+
+    const uint64_t value = m_submittedValue + 1;
+    auto completion = createCompletion();
+
+    vector<vk::SemaphoreSubmitInfo> signalSemaphoreInfos;
+    if (m_timelineSemaphore)
     {
-        m_device->resetFences(*m_fence, dld());
-        m_fenceResetNeeded = false;
+        signalSemaphoreInfos.assign(submitInfo.pSignalSemaphoreInfos, submitInfo.pSignalSemaphoreInfos + submitInfo.signalSemaphoreInfoCount);
+        signalSemaphoreInfos.emplace_back(*m_timelineSemaphore, value, vk::PipelineStageFlagBits2::eAllCommands);
+
+        submitInfo.signalSemaphoreInfoCount = signalSemaphoreInfos.size();
+        submitInfo.pSignalSemaphoreInfos = signalSemaphoreInfos.data();
     }
-    submit(submitInfo, *m_fence, dld());
-    m_fenceResetNeeded = true;
+
+    submit2(submitInfo, completion->fence(), dld());
+    completion->m_submitted = true;
+
+    addInFlight(completion, value);
+    return completion;
 }
 void Queue::waitForCommandsFinished()
 {
-    auto result = m_device->waitForFences(
-        *m_fence,
-        true,
+    shared_ptr<Completion> lastCompletion;
+    {
+        lock_guard<mutex> locker(m_inFlightMutex);
+        lastCompletion = m_lastCompletion;
+    }
+    if (!lastCompletion)
+        return;
+
+    const bool finished = lastCompletion->wait(
 #ifdef QMVK_WAIT_TIMEOUT_MS
-        QMVK_WAIT_TIMEOUT_MS * static_cast<uint64_t>(1e6),
-#else
-        numeric_limits<uint64_t>::max(),
+        QMVK_WAIT_TIMEOUT_MS * static_cast<uint64_t>(1e6)
 #endif
-        dld()
     );
-    if (result == vk::Result::eTimeout)
-        throw vk::SystemError(vk::make_error_code(result), "vkWaitForFences");
+    if (!finished)
+        throw vk::SystemError(vk::make_error_code(vk::Result::eTimeout), "vkWaitForFences");
+
+    m_device->collectReleases();
+}
+
+bool Queue::hasFinished(uint64_t value)
+{
+    if (value == 0)
+        return true;
+
+    if (m_timelineSemaphore)
+        return (m_device->getSemaphoreCounterValue(*m_timelineSemaphore, dld()) >= value);
+
+    vector<shared_ptr<Completion>> completions;
+
+    {
+        lock_guard<mutex> locker(m_inFlightMutex);
+        for (auto &&inFlight : m_inFlight)
+        {
+            if (inFlight.first > value)
+                break;
+            if (auto completion = inFlight.second.lock())
+                completions.push_back(move(completion));
+        }
+    }
+
+    for (auto &&completion : completions)
+    {
+        if (!completion->isDone())
+            return false;
+    }
+    return true;
+}
+
+void Queue::collectCompletions()
+{
+    vector<shared_ptr<Completion>> completions;
+
+    {
+        lock_guard<mutex> locker(m_inFlightMutex);
+        for (auto &&inFlight : m_inFlight)
+        {
+            if (auto completion = inFlight.second.lock())
+                completions.push_back(move(completion));
+        }
+    }
+
+    // Submissions finish in order, so the first unfinished one ends the search
+    for (auto &&completion : completions)
+    {
+        if (!completion->isDone())
+            break;
+    }
+}
+
+shared_ptr<Completion> Queue::createCompletion()
+{
+    {
+        lock_guard<mutex> locker(m_inFlightMutex);
+        while (!m_inFlight.empty() && m_inFlight.front().second.expired())
+            m_inFlight.pop_front();
+    }
+
+    return Completion::create(
+        m_device,
+        weak_from_this(),
+        acquireFence()
+    );
+}
+void Queue::addInFlight(const shared_ptr<Completion> &completion, uint64_t value)
+{
+    {
+        lock_guard<mutex> locker(m_inFlightMutex);
+        m_inFlight.emplace_back(value, completion);
+        m_lastCompletion = completion;
+    }
+
+    m_submittedValue = value;
+
+    m_device->collectReleases();
+}
+
+vk::Fence Queue::acquireFence()
+{
+    lock_guard<mutex> locker(m_fenceMutex);
+
+    if (m_freeFences.empty())
+        return m_device->createFence(vk::FenceCreateInfo(), m_device->allocationCallbacks(), dld());
+
+    auto fence = m_freeFences.back();
+    m_freeFences.pop_back();
+    return fence;
+}
+void Queue::recycleFence(vk::Fence fence)
+{
+    m_device->resetFences(fence, dld());
+
+    lock_guard<mutex> locker(m_fenceMutex);
+    m_freeFences.push_back(fence);
 }
 
 }
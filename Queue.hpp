@@ -11,16 +11,21 @@
 #include <vulkan/vulkan.hpp>
 
 #include <memory>
+#include <atomic>
 #include <mutex>
+#include <deque>
 
 namespace QmVk {
 
 using namespace std;
 
 class Device;
+class Completion;
 
-class QMVK_EXPORT Queue : public vk::Queue
+class QMVK_EXPORT Queue : public vk::Queue, public enable_shared_from_this<Queue>
 {
+    friend class Completion;
+
 public:
     static shared_ptr<Queue> create(
         const shared_ptr<Device> &device,
@@ -48,19 +53,45 @@ public:
 
     unique_lock<mutex> lock();
 
-    void submitCommandBuffer(vk::SubmitInfo &&submitInfo);
+    // Must be called with the queue locked, uses "vkQueueSubmit2" if possible
+    shared_ptr<Completion> submitCommandBuffer(vk::SubmitInfo &&submitInfo);
+    // Requires synchronization2, allows precise semaphore stage masks
+    shared_ptr<Completion> submitCommandBuffer(vk::SubmitInfo2 &&submitInfo);
+    // Waits for the last submission
     void waitForCommandsFinished();
 
+    // Each submission increments the value, it's signaled on the timeline semaphore if available
+    inline uint64_t submittedValue() const;
+    bool hasFinished(uint64_t value);
+
+    // Finishes signaled completions, so their callbacks are called and their data is released without
+    // waiting. Called after each "CommandBuffer::submitAsync()" which locks the queue by itself.
+    void collectCompletions();
+
+private:
+    shared_ptr<Completion> createCompletion();
+    void addInFlight(const shared_ptr<Completion> &completion, uint64_t value);
+
+    vk::Fence acquireFence();
+    void recycleFence(vk::Fence fence);
+
 private:
     const shared_ptr<Device> m_device;
     const vk::detail::DispatchLoaderDynamic &m_dld;
     const uint32_t m_queueFamilyIndex;
     const uint32_t m_queueIndex;
 
-    bool m_fenceResetNeeded = false;
-    vk::UniqueFence m_fence;
-
     mutex m_mutex;
+
+    vk::UniqueSemaphore m_timelineSemaphore;
+    atomic<uint64_t> m_submittedValue {0};
+
+    mutex m_fenceMutex;
+    vector<vk::Fence> m_freeFences;
+
+    mutex m_inFlightMutex; // guards both below
+    deque<pair<uint64_t, weak_ptr<Completion>>> m_inFlight;
+    shared_ptr<Completion> m_lastCompletion;
 };
 
 /* Inline implementation */
@@ -83,4 +114,9 @@ uint32_t Queue::queueIndex() const
     return m_queueIndex;
 }
 
+uint64_t Queue::submittedValue() const
+{
+    return m_submittedValue;
+}
+
 }
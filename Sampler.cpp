@@ -65,7 +65,7 @@ void Sampler::init()
 
     if (m_ycbcrCreateInfo.format != vk::Format::eUndefined)
     {
-        m_samplerYcbcr = m_device->createSamplerYcbcrConversionKHRUnique(m_ycbcrCreateInfo, nullptr, m_device->dld());
+        m_samplerYcbcr = m_device->createSamplerYcbcrConversionUnique(m_ycbcrCreateInfo, m_device->allocationCallbacks(), m_device->dld());
 
         samplerYcbcrInfo.pNext = m_createInfo.pNext;
         m_createInfo.pNext = &samplerYcbcrInfo;
@@ -73,7 +73,7 @@ void Sampler::init()
         samplerYcbcrInfo.conversion = *m_samplerYcbcr;
     }
 
-    m_sampler = m_device->createSamplerUnique(m_createInfo, nullptr, m_device->dld());
+    m_sampler = m_device->createSamplerUnique(m_createInfo, m_device->allocationCallbacks(), m_device->dld());
 
     m_createInfo.pNext = nullptr;
     m_ycbcrCreateInfo.pNext = nullptr;
@@ -49,7 +49,7 @@ void Semaphore::init()
         exportCreateInfo.handleTypes = *m_handleType;
         createInfo.pNext = &exportCreateInfo;
     }
-    m_semaphore = m_device->createSemaphoreUnique(createInfo, nullptr, m_device->dld());
+    m_semaphore = m_device->createSemaphoreUnique(createInfo, m_device->allocationCallbacks(), m_device->dld());
 }
 
 int Semaphore::exportFD()
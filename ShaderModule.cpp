@@ -37,7 +37,21 @@ void ShaderModule::init(const vector<uint32_t> &data)
     createInfo.codeSize = data.size() * sizeof(uint32_t);
     createInfo.pCode = data.data();
 
-    m_shaderModule = m_device->createShaderModuleUnique(createInfo, nullptr, m_device->dld());
+    m_shaderModule = m_device->createShaderModuleUnique(createInfo, m_device->allocationCallbacks(), m_device->dld());
+
+    if (m_device->hasShaderObject())
+        m_code = data;
+
+    // FNV-1a
+    m_hash = 0xcbf29ce484222325;
+    for (auto &&word : data)
+    {
+        for (uint32_t i = 0; i < sizeof(uint32_t); ++i)
+        {
+            m_hash ^= (word >> (i * 8)) & 0xff;
+            m_hash *= 0x100000001b3;
+        }
+    }
 }
 
 vk::PipelineShaderStageCreateInfo ShaderModule::getPipelineShaderStageCreateInfo(
@@ -52,4 +66,22 @@ vk::PipelineShaderStageCreateInfo ShaderModule::getPipelineShaderStageCreateInfo
     );
 }
 
+vk::ShaderCreateInfoEXT ShaderModule::getShaderCreateInfo(
+    const vk::SpecializationInfo &specializationInfo,
+    vk::ShaderStageFlags nextStage) const
+{
+    if (m_code.empty())
+        throw vk::LogicError("Shader objects are not supported");
+
+    vk::ShaderCreateInfoEXT shaderCreateInfo;
+    shaderCreateInfo.stage = m_stage;
+    shaderCreateInfo.nextStage = nextStage;
+    shaderCreateInfo.codeType = vk::ShaderCodeTypeEXT::eSpirv;
+    shaderCreateInfo.codeSize = m_code.size() * sizeof(uint32_t);
+    shaderCreateInfo.pCode = m_code.data();
+    shaderCreateInfo.pName = "main";
+    shaderCreateInfo.pSpecializationInfo = &specializationInfo;
+    return shaderCreateInfo;
+}
+
 }
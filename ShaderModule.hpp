@@ -40,15 +40,27 @@ private:
 public:
     inline vk::ShaderStageFlagBits stage() const;
 
+    // Hash of the SPIR-V code
+    inline uint64_t hash() const;
+
     vk::PipelineShaderStageCreateInfo getPipelineShaderStageCreateInfo(
         const vk::SpecializationInfo &specializationInfo
     ) const;
 
+    // SPIR-V code is kept only if the device supports shader objects
+    vk::ShaderCreateInfoEXT getShaderCreateInfo(
+        const vk::SpecializationInfo &specializationInfo,
+        vk::ShaderStageFlags nextStage = {}
+    ) const;
+
 private:
     const shared_ptr<Device> m_device;
     const vk::ShaderStageFlagBits m_stage;
 
+    uint64_t m_hash = 0;
+
     vk::UniqueShaderModule m_shaderModule;
+    vector<uint32_t> m_code;
 };
 
 /* Inline implementation */
@@ -58,4 +70,9 @@ vk::ShaderStageFlagBits ShaderModule::stage() const
     return m_stage;
 }
 
+uint64_t ShaderModule::hash() const
+{
+    return m_hash;
+}
+
 }
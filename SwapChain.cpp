@@ -9,6 +9,8 @@
 #include "Device.hpp"
 #include "Queue.hpp"
 #include "RenderPass.hpp"
+#include "CommandBuffer.hpp"
+#include "BarrierBatch.hpp"
 #include "Semaphore.hpp"
 
 namespace QmVk {
@@ -50,6 +52,7 @@ SwapChain::SwapChain(CreateInfo &createInfo)
     , m_dld(m_device->dld())
     , m_queue(move(createInfo.queue))
     , m_renderPass(move(createInfo.renderPass))
+    , m_format(m_renderPass ? m_renderPass->format() : createInfo.format)
     , m_surface(move(createInfo.surface))
     , m_oldSwapChain(move(createInfo.oldSwapChain))
 {}
@@ -58,6 +61,9 @@ SwapChain::~SwapChain()
 
 void SwapChain::init(CreateInfo &createInfo)
 {
+    if (!m_renderPass && !m_device->hasDynamicRendering())
+        throw vk::LogicError("SwapChain without render pass requires dynamic rendering");
+
     const auto physicalDevice = m_device->physicalDevice();
 
     const auto surfaceCapabilities = physicalDevice->getSurfaceCapabilitiesKHR(m_surface, m_dld);
@@ -115,7 +121,7 @@ void SwapChain::init(CreateInfo &createInfo)
     vk::SwapchainCreateInfoKHR vkCreateInfo;
     vkCreateInfo.surface = m_surface;
     vkCreateInfo.minImageCount = createInfo.imageCount;
-    vkCreateInfo.imageFormat = m_renderPass->format();
+    vkCreateInfo.imageFormat = m_format;
     vkCreateInfo.imageColorSpace = createInfo.colorSpace;
     vkCreateInfo.imageExtent = m_size;
     vkCreateInfo.imageArrayLayers = 1;
@@ -134,31 +140,34 @@ void SwapChain::init(CreateInfo &createInfo)
         vkCreateInfo.pNext = &surfaceFullScreenExclusiveInfo;
     }
 #endif
-    m_swapChain = m_device->createSwapchainKHRUnique(vkCreateInfo, nullptr, m_dld);
+    m_swapChain = m_device->createSwapchainKHRUnique(vkCreateInfo, m_device->allocationCallbacks(), m_dld);
 
     m_oldSwapChain.reset();
 
-    const auto swapChainImages = m_device->getSwapchainImagesKHR(*m_swapChain, m_dld);
-    for (auto &&swapChainImage : swapChainImages)
+    m_swapChainImages = m_device->getSwapchainImagesKHR(*m_swapChain, m_dld);
+    for (auto &&swapChainImage : m_swapChainImages)
     {
         vk::ImageViewCreateInfo imageViewCreateInfo;
         imageViewCreateInfo.image = swapChainImage;
         imageViewCreateInfo.viewType = vk::ImageViewType::e2D;
-        imageViewCreateInfo.format = m_renderPass->format();
+        imageViewCreateInfo.format = m_format;
         imageViewCreateInfo.components = vk::ComponentMapping();
         imageViewCreateInfo.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
         imageViewCreateInfo.subresourceRange.levelCount = 1;
         imageViewCreateInfo.subresourceRange.layerCount = 1;
-        m_swapChainImageViews.push_back(m_device->createImageViewUnique(imageViewCreateInfo, nullptr, m_dld));
+        m_swapChainImageViews.push_back(m_device->createImageViewUnique(imageViewCreateInfo, m_device->allocationCallbacks(), m_dld));
 
-        vk::FramebufferCreateInfo framebufferCreateInfo;
-        framebufferCreateInfo.renderPass = *m_renderPass;
-        framebufferCreateInfo.attachmentCount = 1;
-        framebufferCreateInfo.pAttachments = &m_swapChainImageViews.back().get();
-        framebufferCreateInfo.width = m_size.width;
-        framebufferCreateInfo.height = m_size.height;
-        framebufferCreateInfo.layers = 1;
-        m_frameBuffers.push_back(m_device->createFramebufferUnique(framebufferCreateInfo, nullptr, m_dld));
+        if (m_renderPass)
+        {
+            vk::FramebufferCreateInfo framebufferCreateInfo;
+            framebufferCreateInfo.renderPass = *m_renderPass;
+            framebufferCreateInfo.attachmentCount = 1;
+            framebufferCreateInfo.pAttachments = &m_swapChainImageViews.back().get();
+            framebufferCreateInfo.width = m_size.width;
+            framebufferCreateInfo.height = m_size.height;
+            framebufferCreateInfo.layers = 1;
+            m_frameBuffers.push_back(m_device->createFramebufferUnique(framebufferCreateInfo, m_device->allocationCallbacks(), m_dld));
+        }
 
         m_renderFinishedSem.push_back(Semaphore::create(m_device));
     }
@@ -166,6 +175,65 @@ void SwapChain::init(CreateInfo &createInfo)
     m_imageAvailableSem = Semaphore::create(m_device);
 }
 
+void SwapChain::beginRendering(
+    const shared_ptr<CommandBuffer> &commandBuffer,
+    uint32_t imageIdx,
+    bool clear,
+    const vk::ClearColorValue &clearColor)
+{
+    vk::ImageMemoryBarrier barrier(
+        vk::AccessFlags(),
+        vk::AccessFlagBits::eColorAttachmentWrite,
+        vk::ImageLayout::eUndefined,
+        vk::ImageLayout::eColorAttachmentOptimal,
+        VK_QUEUE_FAMILY_IGNORED,
+        VK_QUEUE_FAMILY_IGNORED,
+        m_swapChainImages.at(imageIdx),
+        vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1)
+    );
+
+    // Waits for the image acquire semaphore which is waited at the same stage
+    BarrierBatch barrierBatch(*commandBuffer, *m_device);
+    barrierBatch.addImageBarrier(
+        g_waitStage,
+        vk::PipelineStageFlagBits::eColorAttachmentOutput,
+        barrier
+    );
+    barrierBatch.flush();
+
+    commandBuffer->beginDynamicRendering(
+        *m_swapChainImageViews[imageIdx],
+        m_size,
+        clear ? vk::AttachmentLoadOp::eClear : vk::AttachmentLoadOp::eDontCare,
+        clearColor
+    );
+}
+void SwapChain::endRendering(
+    const shared_ptr<CommandBuffer> &commandBuffer,
+    uint32_t imageIdx)
+{
+    commandBuffer->endDynamicRendering();
+
+    vk::ImageMemoryBarrier barrier(
+        vk::AccessFlagBits::eColorAttachmentWrite,
+        vk::AccessFlags(),
+        vk::ImageLayout::eColorAttachmentOptimal,
+        vk::ImageLayout::ePresentSrcKHR,
+        VK_QUEUE_FAMILY_IGNORED,
+        VK_QUEUE_FAMILY_IGNORED,
+        m_swapChainImages.at(imageIdx),
+        vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1)
+    );
+
+    BarrierBatch barrierBatch(*commandBuffer, *m_device);
+    barrierBatch.addImageBarrier(
+        vk::PipelineStageFlagBits::eColorAttachmentOutput,
+        vk::PipelineStageFlagBits::eBottomOfPipe,
+        barrier
+    );
+    barrierBatch.flush();
+}
+
 vk::SubmitInfo SwapChain::getSubmitInfo(uint32_t imageIdx) const
 {
     vk::SubmitInfo submitInfo;
@@ -20,6 +20,7 @@ class Device;
 class Queue;
 class RenderPass;
 class Semaphore;
+class CommandBuffer;
 
 class QMVK_EXPORT SwapChain
 {
@@ -28,7 +29,8 @@ public:
     {
         shared_ptr<Device> device;
         shared_ptr<Queue> queue;
-        shared_ptr<RenderPass> renderPass;
+        shared_ptr<RenderPass> renderPass; // "nullptr" for dynamic rendering, no framebuffers are created
+        vk::Format format = vk::Format::eUndefined; // required for dynamic rendering
         vk::SurfaceKHR surface;
         vk::Extent2D fallbackSize;
         vector<vk::PresentModeKHR> presentModes;
@@ -62,7 +64,22 @@ public:
 
     inline bool maybeSuboptimal() const;
 
+    inline vk::Format format() const;
+
     inline vk::Framebuffer frameBuffer(uint32_t idx) const;
+    inline vk::ImageView imageView(uint32_t idx) const;
+
+    // Dynamic rendering, transitions the image to the color attachment layout and back to the present layout
+    void beginRendering(
+        const shared_ptr<CommandBuffer> &commandBuffer,
+        uint32_t imageIdx,
+        bool clear = false,
+        const vk::ClearColorValue &clearColor = {}
+    );
+    void endRendering(
+        const shared_ptr<CommandBuffer> &commandBuffer,
+        uint32_t imageIdx
+    );
 
     vk::SubmitInfo getSubmitInfo(uint32_t imageIdx) const;
 
@@ -76,6 +93,7 @@ private:
     const vk::detail::DispatchLoaderDynamic &m_dld;
     const shared_ptr<Queue> m_queue;
     const shared_ptr<RenderPass> m_renderPass;
+    const vk::Format m_format;
     const vk::SurfaceKHR m_surface;
     vk::UniqueSwapchainKHR m_oldSwapChain;
 
@@ -85,6 +103,7 @@ private:
 
     vk::UniqueSwapchainKHR m_swapChain;
 
+    vector<vk::Image> m_swapChainImages;
     vector<vk::UniqueImageView> m_swapChainImageViews;
     vector<vk::UniqueFramebuffer> m_frameBuffers;
 
@@ -104,9 +123,18 @@ bool SwapChain::maybeSuboptimal() const
     return m_maybeSuboptimal;
 }
 
+vk::Format SwapChain::format() const
+{
+    return m_format;
+}
+
 vk::Framebuffer SwapChain::frameBuffer(uint32_t idx) const
 {
     return *m_frameBuffers[idx];
 }
+vk::ImageView SwapChain::imageView(uint32_t idx) const
+{
+    return *m_swapChainImageViews[idx];
+}
 
 }
@@ -0,0 +1,222 @@
+// SPDX-License-Identifier: MIT
+/*
+   QmVk - simple Vulkan library created for QMPlay2
+   Copyright (C) 2020-2025 Błażej Szczygieł
+*/
+
+#include "TransferBatch.hpp"
+#include "MemoryObjectBase.hpp"
+#include "Device.hpp"
+#include "Completion.hpp"
+#include "Queue.hpp"
+
+namespace QmVk {
+
+static void waitForCompletion(const shared_ptr<Completion> &completion)
+{
+    const bool finished = completion->wait(
+#ifdef QMVK_WAIT_TIMEOUT_MS
+        QMVK_WAIT_TIMEOUT_MS * static_cast<uint64_t>(1e6)
+#endif
+    );
+    if (!finished)
+        throw vk::SystemError(vk::make_error_code(vk::Result::eTimeout), "vkWaitForFences");
+}
+
+shared_ptr<TransferBatch> TransferBatch::create(
+    const shared_ptr<Device> &device,
+    uint32_t maxOperations,
+    chrono::milliseconds maxDelay)
+{
+    auto transferBatch = make_shared<TransferBatch>(
+        device,
+        maxOperations,
+        maxDelay
+    );
+    transferBatch->init();
+    return transferBatch;
+}
+
+TransferBatch::TransferBatch(
+    const shared_ptr<Device> &device,
+    uint32_t maxOperations,
+    chrono::milliseconds maxDelay)
+    : m_device(device)
+    , m_maxOperations(max(maxOperations, 1u))
+    , m_maxDelay(maxDelay)
+{}
+TransferBatch::~TransferBatch()
+{
+    {
+        lock_guard<mutex> locker(m_mutex);
+        m_stopFlushThread = true;
+    }
+    m_cond.notify_one();
+    if (m_flushThread.joinable())
+        m_flushThread.join();
+
+    try
+    {
+        flush();
+    }
+    catch (...)
+    {
+        // E.g. device lost, pending operations are dropped
+    }
+}
+
+void TransferBatch::init()
+{
+    m_commandBuffer = CommandBuffer::create(m_device->firstQueue());
+    m_flushThread = thread(&TransferBatch::flushThread, this);
+}
+
+void TransferBatch::begin()
+{
+    lock_guard<mutex> locker(m_mutex);
+
+    if (m_beginCount == 0)
+    {
+        m_device->setTransferBatch(shared_from_this());
+        m_ownerThread = this_thread::get_id();
+    }
+    else if (m_ownerThread != this_thread::get_id())
+    {
+        throw vk::LogicError("Transfer batch is already active on another thread");
+    }
+
+    ++m_beginCount;
+}
+void TransferBatch::end()
+{
+    {
+        lock_guard<mutex> locker(m_mutex);
+
+        if (m_beginCount == 0)
+            throw vk::LogicError("Transfer batch is not active");
+
+        if (--m_beginCount > 0)
+            return;
+    }
+
+    flush();
+
+    lock_guard<mutex> locker(m_mutex);
+    if (m_beginCount == 0)
+        m_device->resetTransferBatch(this);
+}
+
+bool TransferBatch::isActive() const
+{
+    lock_guard<mutex> locker(m_mutex);
+    return (m_beginCount > 0);
+}
+uint32_t TransferBatch::pendingOperations() const
+{
+    lock_guard<mutex> locker(m_mutex);
+    return m_pendingOperations;
+}
+
+bool TransferBatch::record(
+    const CommandBuffer::CommandCallback &callback,
+    const vector<shared_ptr<MemoryObjectBase>> &memoryObjects)
+{
+    {
+        lock_guard<mutex> locker(m_mutex);
+
+        if (m_beginCount == 0 || m_ownerThread != this_thread::get_id())
+            return false;
+
+        if (m_pendingOperations == 0)
+        {
+            m_commandBuffer->resetAndBegin();
+            m_firstPendingTime = chrono::steady_clock::now();
+            m_cond.notify_one();
+        }
+
+        for (auto &&memoryObject : memoryObjects)
+            m_commandBuffer->storeData(memoryObject);
+        callback(*m_commandBuffer);
+
+        ++m_pendingOperations;
+
+        if (m_pendingOperations < m_maxOperations && chrono::steady_clock::now() - m_firstPendingTime < m_maxDelay)
+            return true;
+    }
+
+    flush();
+    return true;
+}
+
+void TransferBatch::flush()
+{
+    // The queue is always locked before the batch
+    auto queueLock = m_commandBuffer->queue()->lock();
+    unique_lock<mutex> locker(m_mutex);
+
+    auto completion = submitPending();
+
+    locker.unlock();
+    queueLock.unlock();
+
+    if (completion)
+        waitForCompletion(completion);
+}
+
+void TransferBatch::flushBeforeSubmit(const CommandBuffer *commandBuffer, bool queueLocked)
+{
+    if (commandBuffer == m_commandBuffer.get())
+        return;
+
+    if (!queueLocked || commandBuffer->queue() != m_commandBuffer->queue())
+    {
+        flush();
+        return;
+    }
+
+    // The caller holds the queue lock, so the batch can be locked without a deadlock. Commands submitted
+    // later to the same queue are synchronized with the batch by image and buffer barriers.
+    lock_guard<mutex> locker(m_mutex);
+    submitPending();
+}
+
+void TransferBatch::flushThread()
+{
+    unique_lock<mutex> locker(m_mutex);
+    while (!m_stopFlushThread)
+    {
+        if (m_pendingOperations == 0)
+        {
+            m_cond.wait(locker);
+            continue;
+        }
+
+        const auto deadline = m_firstPendingTime + m_maxDelay;
+        if (m_cond.wait_until(locker, deadline) != cv_status::timeout || m_stopFlushThread)
+            continue;
+        if (m_pendingOperations == 0 || chrono::steady_clock::now() < m_firstPendingTime + m_maxDelay)
+            continue;
+
+        locker.unlock();
+        try
+        {
+            flush();
+        }
+        catch (const vk::SystemError &)
+        {
+            // The error will be reported by the next operation on the device
+        }
+        locker.lock();
+    }
+}
+
+shared_ptr<Completion> TransferBatch::submitPending()
+{
+    if (m_pendingOperations == 0)
+        return nullptr;
+
+    m_pendingOperations = 0;
+    return m_commandBuffer->submitAsync(false, nullptr, vk::SubmitInfo());
+}
+
+}
@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: MIT
+/*
+   QmVk - simple Vulkan library created for QMPlay2
+   Copyright (C) 2020-2025 Błażej Szczygieł
+*/
+
+#pragma once
+
+#include "QmVkExport.hpp"
+
+#include "CommandBuffer.hpp"
+
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+#include <mutex>
+
+namespace QmVk {
+
+using namespace std;
+
+class MemoryObjectBase;
+class Completion;
+class Device;
+
+/*
+ * Collects internal transfer operations (copies, fills) which are executed
+ * without an external command buffer and submits them at once.
+ *
+ * Operations are batched only between "begin()" and "end()" and only when
+ * they come from the thread which called "begin()". Pending operations are
+ * flushed on "end()", on "flush()", when the operation count or time limit
+ * is reached, or before host memory mapping.
+ *
+ * Image layouts and buffer stages are updated when an operation is recorded,
+ * not when it's executed, so other command buffers and internal operations
+ * flush the batch before they're submitted.
+ */
+class QMVK_EXPORT TransferBatch : public enable_shared_from_this<TransferBatch>
+{
+public:
+    static shared_ptr<TransferBatch> create(
+        const shared_ptr<Device> &device,
+        uint32_t maxOperations = 64,
+        chrono::milliseconds maxDelay = chrono::milliseconds(10)
+    );
+
+public:
+    TransferBatch(
+        const shared_ptr<Device> &device,
+        uint32_t maxOperations,
+        chrono::milliseconds maxDelay
+    );
+    ~TransferBatch();
+
+private:
+    void init();
+
+public:
+    inline shared_ptr<Device> device() const;
+
+    void begin();
+    void end();
+
+    bool isActive() const;
+    uint32_t pendingOperations() const;
+
+    // Returns false if the operation must be executed immediately by the caller
+    bool record(
+        const CommandBuffer::CommandCallback &callback,
+        const vector<shared_ptr<MemoryObjectBase>> &memoryObjects
+    );
+
+    void flush();
+
+    // Called before submitting another command buffer, "queueLocked" means that the caller holds the queue
+    // lock. If it's the queue of the batch, pending operations are submitted without waiting.
+    void flushBeforeSubmit(const CommandBuffer *commandBuffer, bool queueLocked);
+
+private:
+    void flushThread();
+
+    // Must be called with the queue and the batch locked
+    shared_ptr<Completion> submitPending();
+
+private:
+    const shared_ptr<Device> m_device;
+    const uint32_t m_maxOperations;
+    const chrono::milliseconds m_maxDelay;
+
+    shared_ptr<CommandBuffer> m_commandBuffer;
+
+    mutable mutex m_mutex; // never held while locking the queue
+    thread::id m_ownerThread;
+    uint32_t m_beginCount = 0;
+    uint32_t m_pendingOperations = 0;
+    chrono::steady_clock::time_point m_firstPendingTime;
+
+    // Flushes pending operations when the time limit passes without a new operation
+    condition_variable m_cond;
+    bool m_stopFlushThread = false;
+    thread m_flushThread;
+};
+
+/* Inline implementation */
+
+shared_ptr<Device> TransferBatch::device() const
+{
+    return m_device;
+}
+
+}
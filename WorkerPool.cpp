@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: MIT
+/*
+   QmVk - simple Vulkan library created for QMPlay2
+   Copyright (C) 2020-2025 Błażej Szczygieł
+*/
+
+#include "WorkerPool.hpp"
+
+#include <algorithm>
+
+namespace QmVk {
+
+WorkerPool::WorkerPool(uint32_t maxThreads)
+    : m_maxThreads((maxThreads > 0)
+        ? maxThreads
+        : max(thread::hardware_concurrency(), 2u) - 1
+    )
+{}
+WorkerPool::~WorkerPool()
+{
+    {
+        lock_guard<mutex> locker(m_mutex);
+        m_stop = true;
+    }
+    m_cond.notify_all();
+
+    for (auto &&thread : m_threads)
+        thread.join();
+}
+
+void WorkerPool::enqueue(Job &&job)
+{
+    {
+        lock_guard<mutex> locker(m_mutex);
+        if (m_threads.empty())
+            startThreads();
+        m_jobs.push_back(move(job));
+    }
+    m_cond.notify_one();
+}
+
+void WorkerPool::startThreads()
+{
+    m_threads.reserve(m_maxThreads);
+    for (uint32_t i = 0; i < m_maxThreads; ++i)
+        m_threads.emplace_back(&WorkerPool::run, this);
+}
+
+void WorkerPool::run()
+{
+    for (;;)
+    {
+        Job job;
+
+        {
+            unique_lock<mutex> locker(m_mutex);
+            m_cond.wait(locker, [this] {
+                return (m_stop || !m_jobs.empty());
+            });
+            // Remaining jobs are finished before stopping
+            if (m_jobs.empty())
+                break;
+            job = move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+
+        job();
+    }
+}
+
+}
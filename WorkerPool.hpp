@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: MIT
+/*
+   QmVk - simple Vulkan library created for QMPlay2
+   Copyright (C) 2020-2025 Błażej Szczygieł
+*/
+
+#pragma once
+
+#include "QmVkExport.hpp"
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <mutex>
+
+namespace QmVk {
+
+using namespace std;
+
+/*
+ * Per-device pool of worker threads for work which shouldn't block the
+ * calling thread, e.g. pipeline compilation. Threads are started on the
+ * first submitted job.
+ */
+class QMVK_EXPORT WorkerPool
+{
+public:
+    using Job = function<void()>;
+
+public:
+    WorkerPool(uint32_t maxThreads = 0); // "0" - number of CPU threads - 1
+    ~WorkerPool();
+
+public:
+    template<typename F>
+    inline auto submit(F &&job) -> future<decltype(job())>;
+
+    void enqueue(Job &&job);
+
+private:
+    void startThreads();
+    void run();
+
+private:
+    const uint32_t m_maxThreads;
+
+    mutex m_mutex;
+    condition_variable m_cond;
+    deque<Job> m_jobs;
+    bool m_stop = false;
+
+    vector<thread> m_threads;
+};
+
+/* Inline implementation */
+
+template<typename F>
+auto WorkerPool::submit(F &&job) -> future<decltype(job())>
+{
+    // Exceptions thrown by the job are passed to the future
+    auto task = make_shared<packaged_task<decltype(job())()>>(forward<F>(job));
+    auto result = task->get_future();
+    enqueue([task] {
+        (*task)();
+    });
+    return result;
+}
+
+}